@@ -0,0 +1,76 @@
+#include "Audio.h"
+#include <iostream>
+
+void SquareWave::fill(int16_t *out, size_t count, bool on)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        // which half of the period this sample falls in
+        bool high = (static_cast<uint64_t>(phase) * 2 * TONE_HZ / SAMPLE_RATE) & 0x1;
+        out[i] = on ? (high ? TONE_VOLUME : -TONE_VOLUME) : 0;
+        phase = (phase + 1) % SAMPLE_RATE;
+    }
+}
+
+WavAudio::WavAudio(const char *filename)
+{
+    file.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cout << "cannot open audio file\n";
+        exit(1);
+    }
+    write_header();
+}
+
+// the sizes are only known at the end, the header is rewritten then
+WavAudio::~WavAudio()
+{
+    file.seekp(0);
+    write_header();
+}
+
+static void put32(std::ofstream &file, uint32_t value)
+{
+    uint8_t bytes[4] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+                        static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+    file.write(reinterpret_cast<char *>(bytes), 4);
+}
+
+static void put16(std::ofstream &file, uint16_t value)
+{
+    uint8_t bytes[2] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)};
+    file.write(reinterpret_cast<char *>(bytes), 2);
+}
+
+void WavAudio::write_header()
+{
+    uint32_t data = samples * sizeof(int16_t);
+    file.write("RIFF", 4);
+    put32(file, 36 + data);
+    file.write("WAVEfmt ", 8);
+    put32(file, 16);
+    put16(file, 1); // PCM
+    put16(file, 1); // mono
+    put32(file, SAMPLE_RATE);
+    put32(file, SAMPLE_RATE * sizeof(int16_t));
+    put16(file, sizeof(int16_t));
+    put16(file, 16);
+    file.write("data", 4);
+    put32(file, data);
+}
+
+void WavAudio::frame(bool on)
+{
+    int16_t buf[SAMPLES_PER_FRAME];
+    wave.fill(buf, SAMPLES_PER_FRAME, on);
+    // samples are little-endian on disk
+    uint8_t bytes[SAMPLES_PER_FRAME * 2];
+    for (int i = 0; i < SAMPLES_PER_FRAME; ++i)
+    {
+        bytes[2 * i] = static_cast<uint16_t>(buf[i]) & 0xFF;
+        bytes[2 * i + 1] = static_cast<uint16_t>(buf[i]) >> 8;
+    }
+    file.write(reinterpret_cast<char *>(bytes), sizeof(bytes));
+    samples += SAMPLES_PER_FRAME;
+}
@@ -0,0 +1,48 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <fstream>
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#define SAMPLE_RATE 44100
+// samples in one 60 Hz frame
+#define SAMPLES_PER_FRAME (SAMPLE_RATE / 60)
+#define TONE_HZ 440
+#define TONE_VOLUME 4000
+
+// 16-bit mono square wave, the phase carries across calls so a tone that
+// spans frames has no seams
+class SquareWave
+{
+private:
+    uint32_t phase = 0;
+
+public:
+    void fill(int16_t *out, size_t count, bool on);
+};
+
+class Audio
+{
+public:
+    virtual ~Audio() = default;
+    // called once per emulated frame, on while the sound timer is running
+    virtual void frame(bool on) = 0;
+};
+
+// renders to a 16-bit mono WAV file as fast as frames arrive
+class WavAudio : public Audio
+{
+private:
+    std::ofstream file;
+    SquareWave wave;
+    uint32_t samples = 0;
+    void write_header();
+
+public:
+    WavAudio(const char *filename);
+    ~WavAudio();
+    void frame(bool on) override;
+};
+
+#endif // AUDIO_H
@@ -0,0 +1,691 @@
+#include "Batch.h"
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <cstdlib>
+#ifdef BATCH_AVX2
+#include <immintrin.h>
+#endif
+
+Batch::Batch(size_t count)
+    : lanes(count), stride((count + BATCH_WIDTH - 1) / BATCH_WIDTH * BATCH_WIDTH)
+{
+    if (lanes == 0)
+    {
+        std::cout << "batch needs at least one lane\n";
+        exit(1);
+    }
+    RAM.assign(lanes * BATCH_RAM_PITCH, 0);
+    V.assign(REGISTER_COUNT * stride, 0);
+    PC.assign(stride, ROM_START);
+    IC.assign(stride, 0);
+    STACK.assign(STACK_HEIGHT * stride, 0);
+    SP.assign(stride, -1);
+    DTIME.assign(stride, 0);
+    STIME.assign(stride, 0);
+    rng.assign(stride, 0);
+    keys.assign(stride, 0);
+    waiting.assign(stride, 0);
+    wait_reg.assign(stride, 0);
+    live.assign(stride, 0);
+    fb.assign(ROWS * stride, 0);
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        live[lane] = 0xFF;
+        // distinct and reproducible until the caller seeds
+        seed(lane, lane + 1);
+    }
+#ifdef BATCH_AVX2
+    avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+size_t Batch::size()
+{
+    return lanes;
+}
+
+void Batch::load_ROM(char const *filename)
+{
+    std::fstream rom;
+    rom.open(filename, std::ios::binary | std::ios::in);
+    if (!rom.is_open())
+    {
+        std::cout << "cannot open file\n";
+        exit(1);
+    }
+    rom.seekg(0, std::ios::end);
+    size_t length = rom.tellg();
+    rom.seekg(0, std::ios::beg);
+    if (length > RAM_SIZE - ROM_START)
+    {
+        std::cout << "rom too large\n";
+        exit(1);
+    }
+    auto buf = std::make_unique<char[]>(length);
+    rom.read(buf.get(), length);
+    rom.close();
+    // every lane starts from the same image
+    std::fill(image, image + RAM_SIZE, 0);
+    std::copy(buf.get(), buf.get() + length, image + ROM_START);
+    std::copy(FONTSET, FONTSET + FONTSET_SIZE, image + FONTSET_START);
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        std::copy(image, image + RAM_SIZE, &RAM[lane * BATCH_RAM_PITCH]);
+    }
+    std::fill(written, written + RAM_SIZE, false);
+}
+
+void Batch::seed(size_t lane, uint64_t value)
+{
+    // xorshift must never hold zero
+    rng[lane] = value != 0 ? value : 0x9E3779B97F4A7C15ULL;
+}
+
+// several keys going down at once give the lowest, CHIP8 only ever sees one
+void Batch::set_keys(size_t lane, uint16_t mask)
+{
+    uint16_t down = mask & ~keys[lane];
+    keys[lane] = mask;
+    if (waiting[lane] && down != 0)
+    {
+        V[wait_reg[lane] * stride + lane] = __builtin_ctz(down);
+        waiting[lane] = false;
+        PC[lane] += 2;
+    }
+}
+
+void Batch::set_speed(uint64_t instructions_per_frame)
+{
+    ipf = instructions_per_frame;
+    next_tick = cycles + ipf;
+}
+
+uint64_t Batch::cycle_count()
+{
+    return cycles;
+}
+
+uint64_t Batch::run(uint64_t instructions)
+{
+    for (uint64_t i = 0; i < instructions; ++i)
+    {
+        step();
+        if (++cycles >= next_tick)
+        {
+            tick_timers();
+            next_tick += ipf;
+        }
+    }
+    return instructions;
+}
+
+// runs up to and including the next timer tick
+void Batch::run_frame()
+{
+    run(next_tick - cycles);
+}
+
+Framebuffer Batch::framebuffer(size_t lane)
+{
+    Framebuffer screen;
+    for (int row = 0; row < ROWS; ++row)
+    {
+        screen.bits[0][row] = fb[row * stride + lane];
+    }
+    return screen;
+}
+
+void Batch::tick_timers()
+{
+    // plain pointers so the saturating decrement vectorises
+    uint8_t *dt = DTIME.data();
+    uint8_t *st = STIME.data();
+    for (size_t lane = 0; lane < stride; ++lane)
+    {
+        dt[lane] -= dt[lane] > 0;
+        st[lane] -= st[lane] > 0;
+    }
+}
+
+// xorshift64*, top byte of the product
+uint8_t Batch::random_byte(size_t lane)
+{
+    uint64_t &s = rng[lane];
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return (s * 0x2545F4914F6CDD1DULL) >> 56;
+}
+
+// one instruction on every lane. with AVX2 each block of BATCH_WIDTH lanes
+// runs the lanes sharing its leading PC as a vector and steps the rest one
+// at a time
+void Batch::step()
+{
+#ifdef BATCH_AVX2
+    if (avx2)
+    {
+        step_avx2();
+        return;
+    }
+#endif
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        step_lane(lane);
+    }
+    lane_steps += lanes;
+}
+
+// bytes no lane has stored to come from the shared image, which stays in
+// cache where thousands of lane copies would not
+uint8_t Batch::read(size_t lane, uint16_t addr)
+{
+    addr &= RAM_SIZE - 1;
+    return written[addr] ? RAM[lane * BATCH_RAM_PITCH + addr] : image[addr];
+}
+
+uint16_t Batch::fetch_lane(size_t lane)
+{
+    uint16_t addr = PC[lane];
+    PC[lane] += 2;
+    return read(lane, addr) << 8 | read(lane, addr + 1);
+}
+
+// the full instruction set for one lane, same semantics as CHIP8 with its
+// MODERN quirks and a keypad that reports the lane's key mask
+void Batch::step_lane(size_t lane)
+{
+    uint8_t *ram = &RAM[lane * BATCH_RAM_PITCH];
+    uint16_t instruction = fetch_lane(lane);
+    uint8_t x = (instruction >> 8) & 0xF;
+    uint8_t y = (instruction >> 4) & 0xF;
+    uint8_t n = instruction & 0xF;
+    uint8_t kk = instruction & 0xFF;
+    uint16_t nnn = instruction & 0x0FFF;
+    uint8_t &vx = V[x * stride + lane];
+    uint8_t &vy = V[y * stride + lane];
+    uint8_t &vf = V[0xF * stride + lane];
+    uint16_t &pc = PC[lane];
+    uint16_t &ic = IC[lane];
+    int8_t &sp = SP[lane];
+    switch (instruction >> 12)
+    {
+    case 0x0:
+        if (nnn == 0x0E0)
+        {
+            for (int row = 0; row < ROWS; ++row)
+            {
+                fb[row * stride + lane] = 0;
+            }
+        }
+        else if (nnn == 0x0EE)
+        {
+            if (sp <= -1)
+            {
+                std::cout << "nothing to return to\n";
+                exit(1);
+            }
+            pc = STACK[sp * stride + lane];
+            --sp;
+        }
+        // 0NNN machine code routines are ignored
+        break;
+    case 0x1:
+        pc = nnn;
+        break;
+    case 0x2:
+        ++sp;
+        if (sp >= STACK_HEIGHT)
+        {
+            std::cout << "stack overflow\n";
+            exit(1);
+        }
+        STACK[sp * stride + lane] = pc;
+        pc = nnn;
+        break;
+    case 0x3:
+        pc += vx == kk ? 2 : 0;
+        break;
+    case 0x4:
+        pc += vx != kk ? 2 : 0;
+        break;
+    case 0x5:
+        pc += vx == vy ? 2 : 0;
+        break;
+    case 0x6:
+        vx = kk;
+        break;
+    case 0x7:
+        vx += kk;
+        break;
+    case 0x8:
+    {
+        uint8_t a = vx;
+        uint8_t b = vy;
+        switch (n)
+        {
+        case 0x0:
+            vx = b;
+            break;
+        case 0x1:
+            vx = a | b;
+            break;
+        case 0x2:
+            vx = a & b;
+            break;
+        case 0x3:
+            vx = a ^ b;
+            break;
+        case 0x4:
+            vf = static_cast<uint8_t>(a + b) < a;
+            vx = a + b;
+            break;
+        case 0x5:
+            vf = a >= b;
+            vx = a - b;
+            break;
+        case 0x6:
+            // the shifts read Vx after VF is written, as CHIP8 does
+            vf = a & 0x01;
+            vx = vx >> 1;
+            break;
+        case 0x7:
+            vf = b >= a;
+            vx = b - a;
+            break;
+        case 0xE:
+            vf = a >> 7;
+            vx = vx << 1;
+            break;
+        default:
+            std::cout << "reached 0x8___ default\n";
+            exit(1);
+        }
+        break;
+    }
+    case 0x9:
+        pc += vx != vy ? 2 : 0;
+        break;
+    case 0xA:
+        ic = nnn;
+        break;
+    case 0xB:
+        pc = nnn + V[lane];
+        break;
+    case 0xC:
+        vx = random_byte(lane) & kk;
+        break;
+    case 0xD:
+    {
+        uint8_t col = vx & (COLS - 1);
+        uint8_t row = vy & (ROWS - 1);
+        bool collision = false;
+        for (uint8_t i = 0; i < n && row + i < ROWS; ++i)
+        {
+            uint64_t bits = static_cast<uint64_t>(read(lane, ic + i)) << 56 >> col;
+            uint64_t &line = fb[(row + i) * stride + lane];
+            collision |= (line & bits) != 0;
+            line ^= bits;
+        }
+        vf = collision ? 0x1 : 0x0;
+        break;
+    }
+    case 0xE:
+        if (kk != 0x9E && kk != 0xA1)
+        {
+            std::cout << "0xE___ default\n";
+            exit(1);
+        }
+        if (vx > 0xF)
+        {
+            std::cout << "key out of range\n";
+            exit(1);
+        }
+        pc += ((keys[lane] >> vx & 1) != 0) == (kk == 0x9E) ? 2 : 0;
+        break;
+    case 0xF:
+        switch (kk)
+        {
+        case 0x07:
+            vx = DTIME[lane];
+            break;
+        case 0x0A:
+            // parks the lane on this instruction like CHIP8::LDK, only a key
+            // going down in set_keys moves it on
+            waiting[lane] = true;
+            wait_reg[lane] = x;
+            pc -= 2;
+            break;
+        case 0x15:
+            DTIME[lane] = vx;
+            break;
+        case 0x18:
+            STIME[lane] = vx;
+            break;
+        case 0x1E:
+            ic += vx;
+            if (ic > 0x0FFF)
+            {
+                vf = 0x01;
+            }
+            break;
+        case 0x29:
+            ic = FONTSET_START + 5 * (vx & 0xF);
+            break;
+        case 0x33:
+            for (int i = 2, num = vx; i >= 0; --i, num /= 10)
+            {
+                ram[(ic + i) & (RAM_SIZE - 1)] = num % 10;
+                written[(ic + i) & (RAM_SIZE - 1)] = true;
+            }
+            break;
+        case 0x55:
+            for (int i = 0; i <= x; ++i)
+            {
+                ram[(ic + i) & (RAM_SIZE - 1)] = V[i * stride + lane];
+                written[(ic + i) & (RAM_SIZE - 1)] = true;
+            }
+            break;
+        case 0x65:
+            for (int i = 0; i <= x; ++i)
+            {
+                V[i * stride + lane] = read(lane, ic + i);
+            }
+            break;
+        default:
+            std::cout << "0xF___ default\n";
+            exit(1);
+        }
+        break;
+    }
+}
+
+#ifdef BATCH_AVX2
+// instructions that only exist per lane, reading memory, the stack, the
+// keys or the RNG, aren't run as a vector
+static bool vectorizable(uint16_t instruction)
+{
+    uint8_t n = instruction & 0xF;
+    uint8_t kk = instruction & 0xFF;
+    switch (instruction >> 12)
+    {
+    case 0x0:
+        return instruction == 0x00E0;
+    case 0x1:
+    case 0x3:
+    case 0x4:
+    case 0x5:
+    case 0x6:
+    case 0x7:
+    case 0x9:
+    case 0xA:
+        return true;
+    case 0x8:
+        return n <= 0x7 || n == 0xE;
+    case 0xF:
+        return kk == 0x07 || kk == 0x15 || kk == 0x18 || kk == 0x1E;
+    default:
+        return false;
+    }
+}
+
+// byte mask of the live lanes in a block whose PC is pc, packs leaves the
+// halves interleaved
+__attribute__((target("avx2")))
+static __m256i lanes_at(const uint16_t *pc, const uint8_t *live, uint16_t leader)
+{
+    const __m256i *pc_ptr = reinterpret_cast<const __m256i *>(pc);
+    __m256i target = _mm256_set1_epi16(leader);
+    __m256i match = _mm256_packs_epi16(_mm256_cmpeq_epi16(_mm256_loadu_si256(pc_ptr), target),
+                                       _mm256_cmpeq_epi16(_mm256_loadu_si256(pc_ptr + 1), target));
+    return _mm256_and_si256(_mm256_permute4x64_epi64(match, 0xD8),
+                            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(live)));
+}
+
+// of the block's first few PC groups, the biggest whose instruction no lane
+// has stored over and runs as a vector, as pc << 16 | instruction. 0 if
+// none qualifies
+__attribute__((target("avx2")))
+uint32_t Batch::pick_leader(size_t base, uint32_t alive)
+{
+    uint32_t unclaimed = alive;
+    uint32_t best = 0;
+    uint32_t leader = 0;
+    // a group no bigger than the lanes left unclaimed can't beat the best,
+    // and lanes scattered over many PCs gain little from a vector step
+    for (int tried = 0; tried < BATCH_CANDIDATES && __builtin_popcount(unclaimed) > __builtin_popcount(best); ++tried)
+    {
+        uint16_t candidate = PC[base + __builtin_ctz(unclaimed)];
+        uint32_t group = _mm256_movemask_epi8(lanes_at(&PC[base], &live[base], candidate));
+        unclaimed &= ~group;
+        uint16_t addr = candidate & (RAM_SIZE - 1);
+        uint16_t next = (addr + 1) & (RAM_SIZE - 1);
+        uint16_t word = image[addr] << 8 | image[next];
+        if (!written[addr] && !written[next] && vectorizable(word) &&
+            __builtin_popcount(group) > __builtin_popcount(best))
+        {
+            best = group;
+            leader = static_cast<uint32_t>(candidate) << 16 | word;
+        }
+    }
+    return leader;
+}
+
+// each block runs its lanes on the leader's PC together and steps the others
+// one at a time. a block keeps the leader of the one before while that
+// covers all of its lanes, which is every block while the lanes agree
+__attribute__((target("avx2")))
+void Batch::step_avx2()
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i ones = _mm256_set1_epi8(-1);
+    const __m256i two = _mm256_set1_epi16(2);
+    uint16_t pc = 0;
+    // 0000 never runs as a vector, so no block has a leader yet
+    uint16_t instruction = 0x0000;
+    // only a scalar step can store over the leader's instruction
+    bool stored = false;
+    uint64_t together = 0;
+    for (size_t base = 0; base < stride; base += BATCH_WIDTH)
+    {
+        uint32_t alive = _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i *>(&live[base])));
+        __m256i match = lanes_at(&PC[base], &live[base], pc);
+        uint16_t addr = pc & (RAM_SIZE - 1);
+        bool follows = instruction != 0x0000 && static_cast<uint32_t>(_mm256_movemask_epi8(match)) == alive &&
+                       !(stored && (written[addr] || written[(addr + 1) & (RAM_SIZE - 1)]));
+        if (__builtin_expect(!follows, 0))
+        {
+            uint32_t leader = pick_leader(base, alive);
+            if (leader == 0)
+            {
+                for (; alive != 0; alive &= alive - 1)
+                {
+                    step_lane(base + __builtin_ctz(alive));
+                    ++lane_steps;
+                }
+                stored = true;
+                continue;
+            }
+            pc = leader >> 16;
+            instruction = leader & 0xFFFF;
+            match = lanes_at(&PC[base], &live[base], pc);
+        }
+        uint8_t x = (instruction >> 8) & 0xF;
+        uint8_t y = (instruction >> 4) & 0xF;
+        uint8_t n = instruction & 0xF;
+        uint8_t kk = instruction & 0xFF;
+        uint16_t nnn = instruction & 0x0FFF;
+        __m256i *pc_ptr = reinterpret_cast<__m256i *>(&PC[base]);
+        __m256i pc_lo = _mm256_loadu_si256(pc_ptr);
+        __m256i pc_hi = _mm256_loadu_si256(pc_ptr + 1);
+        uint32_t bits = _mm256_movemask_epi8(match);
+        uint32_t rest = alive & ~bits;
+        __m256i match_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(match));
+        __m256i match_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(match, 1));
+        __m256i *vx = reinterpret_cast<__m256i *>(&V[x * stride + base]);
+        __m256i *vy = reinterpret_cast<__m256i *>(&V[y * stride + base]);
+        __m256i *vf = reinterpret_cast<__m256i *>(&V[0xF * stride + base]);
+        __m256i a = _mm256_loadu_si256(vx);
+        __m256i b = _mm256_loadu_si256(vy);
+        // lanes that skip the next instruction
+        __m256i skip = _mm256_setzero_si256();
+        __m256i next_lo = _mm256_add_epi16(pc_lo, two);
+        __m256i next_hi = _mm256_add_epi16(pc_hi, two);
+        switch (instruction >> 12)
+        {
+        case 0x0:
+            for (uint32_t m = bits; m != 0; m &= m - 1)
+            {
+                size_t lane = base + __builtin_ctz(m);
+                for (int row = 0; row < ROWS; ++row)
+                {
+                    fb[row * stride + lane] = 0;
+                }
+            }
+            break;
+        case 0x1:
+            next_lo = next_hi = _mm256_set1_epi16(nnn);
+            break;
+        case 0x3:
+            skip = _mm256_cmpeq_epi8(a, _mm256_set1_epi8(kk));
+            break;
+        case 0x4:
+            skip = _mm256_xor_si256(_mm256_cmpeq_epi8(a, _mm256_set1_epi8(kk)), ones);
+            break;
+        case 0x5:
+            skip = _mm256_cmpeq_epi8(a, b);
+            break;
+        case 0x9:
+            skip = _mm256_xor_si256(_mm256_cmpeq_epi8(a, b), ones);
+            break;
+        case 0x6:
+            _mm256_storeu_si256(vx, _mm256_blendv_epi8(a, _mm256_set1_epi8(kk), match));
+            break;
+        case 0x7:
+            _mm256_storeu_si256(vx, _mm256_blendv_epi8(a, _mm256_add_epi8(a, _mm256_set1_epi8(kk)), match));
+            break;
+        case 0x8:
+        {
+            // VF goes first so that x == F ends up holding the result
+            __m256i result;
+            __m256i flag;
+            bool sets_flag = true;
+            switch (n)
+            {
+            case 0x0:
+                result = b;
+                sets_flag = false;
+                break;
+            case 0x1:
+                result = _mm256_or_si256(a, b);
+                sets_flag = false;
+                break;
+            case 0x2:
+                result = _mm256_and_si256(a, b);
+                sets_flag = false;
+                break;
+            case 0x3:
+                result = _mm256_xor_si256(a, b);
+                sets_flag = false;
+                break;
+            case 0x4:
+                // wrapped iff the saturating sum differs
+                result = _mm256_add_epi8(a, b);
+                flag = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_adds_epu8(a, b), result), one);
+                break;
+            case 0x5:
+                result = _mm256_sub_epi8(a, b);
+                flag = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a), one);
+                break;
+            case 0x6:
+                result = _mm256_and_si256(_mm256_srli_epi16(a, 1), _mm256_set1_epi8(0x7F));
+                flag = _mm256_and_si256(a, one);
+                break;
+            case 0x7:
+                result = _mm256_sub_epi8(b, a);
+                flag = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), b), one);
+                break;
+            default: // 0xE
+                result = _mm256_add_epi8(a, a);
+                flag = _mm256_and_si256(_mm256_srli_epi16(a, 7), one);
+                break;
+            }
+            if (sets_flag)
+            {
+                _mm256_storeu_si256(vf, _mm256_blendv_epi8(_mm256_loadu_si256(vf), flag, match));
+                a = _mm256_loadu_si256(vx);
+            }
+            // the shifts read Vx after VF is written, as CHIP8 does
+            if (n == 0x6)
+            {
+                result = _mm256_and_si256(_mm256_srli_epi16(a, 1), _mm256_set1_epi8(0x7F));
+            }
+            else if (n == 0xE)
+            {
+                result = _mm256_add_epi8(a, a);
+            }
+            _mm256_storeu_si256(vx, _mm256_blendv_epi8(a, result, match));
+            break;
+        }
+        case 0xA:
+        {
+            __m256i *ic = reinterpret_cast<__m256i *>(&IC[base]);
+            __m256i target = _mm256_set1_epi16(nnn);
+            _mm256_storeu_si256(ic, _mm256_blendv_epi8(_mm256_loadu_si256(ic), target, match_lo));
+            _mm256_storeu_si256(ic + 1, _mm256_blendv_epi8(_mm256_loadu_si256(ic + 1), target, match_hi));
+            break;
+        }
+        case 0xF:
+        {
+            __m256i *dt = reinterpret_cast<__m256i *>(&DTIME[base]);
+            __m256i *st = reinterpret_cast<__m256i *>(&STIME[base]);
+            if (kk == 0x07)
+            {
+                _mm256_storeu_si256(vx, _mm256_blendv_epi8(a, _mm256_loadu_si256(dt), match));
+            }
+            else if (kk == 0x15)
+            {
+                _mm256_storeu_si256(dt, _mm256_blendv_epi8(_mm256_loadu_si256(dt), a, match));
+            }
+            else if (kk == 0x18)
+            {
+                _mm256_storeu_si256(st, _mm256_blendv_epi8(_mm256_loadu_si256(st), a, match));
+            }
+            else
+            {
+                __m256i *ic = reinterpret_cast<__m256i *>(&IC[base]);
+                __m256i ic_lo = _mm256_loadu_si256(ic);
+                __m256i ic_hi = _mm256_loadu_si256(ic + 1);
+                __m256i sum_lo = _mm256_add_epi16(ic_lo, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(a)));
+                __m256i sum_hi = _mm256_add_epi16(ic_hi, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(a, 1)));
+                _mm256_storeu_si256(ic, _mm256_blendv_epi8(ic_lo, sum_lo, match_lo));
+                _mm256_storeu_si256(ic + 1, _mm256_blendv_epi8(ic_hi, sum_hi, match_hi));
+                // VF is only ever set, when I leaves the 12-bit range
+                const __m256i high = _mm256_set1_epi16(static_cast<int16_t>(0xF000));
+                const __m256i zero = _mm256_setzero_si256();
+                __m256i inside = _mm256_packs_epi16(_mm256_cmpeq_epi16(_mm256_and_si256(sum_lo, high), zero),
+                                                    _mm256_cmpeq_epi16(_mm256_and_si256(sum_hi, high), zero));
+                inside = _mm256_permute4x64_epi64(inside, 0xD8);
+                __m256i carry = _mm256_andnot_si256(inside, match);
+                _mm256_storeu_si256(vf, _mm256_blendv_epi8(_mm256_loadu_si256(vf), one, carry));
+            }
+            break;
+        }
+        }
+        // skipping lanes move 4 bytes instead of 2
+        next_lo = _mm256_add_epi16(next_lo, _mm256_and_si256(_mm256_cvtepi8_epi16(_mm256_castsi256_si128(skip)), two));
+        next_hi = _mm256_add_epi16(next_hi, _mm256_and_si256(_mm256_cvtepi8_epi16(_mm256_extracti128_si256(skip, 1)), two));
+        _mm256_storeu_si256(pc_ptr, _mm256_blendv_epi8(pc_lo, next_lo, match_lo));
+        _mm256_storeu_si256(pc_ptr + 1, _mm256_blendv_epi8(pc_hi, next_hi, match_hi));
+        together += __builtin_popcount(bits);
+        stored = rest != 0;
+        for (; rest != 0; rest &= rest - 1)
+        {
+            step_lane(base + __builtin_ctz(rest));
+            ++lane_steps;
+        }
+    }
+    vector_steps += together;
+}
+#endif
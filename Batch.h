@@ -0,0 +1,92 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "MachineState.h"
+#include "Font.h"
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BATCH_AVX2
+#endif
+
+// lanes per vector, one byte register per lane in a 256-bit register
+#define BATCH_WIDTH 32
+// PC groups a block looks at when picking the one to run as a vector
+#define BATCH_CANDIDATES 4
+// bytes between lanes' memories, off a multiple of 4K so the same guest
+// address in neighbouring lanes doesn't land in the same cache set
+#define BATCH_RAM_PITCH (RAM_SIZE + 64)
+
+// many machines running the same ROM, kept as structure of arrays so the
+// lanes that agree on PC execute each instruction together with AVX2. each
+// block of BATCH_WIDTH lanes follows the PC most of its lanes share, and
+// lanes that diverged from it step one at a time until they meet up again.
+// runs with the MODERN quirks and no display or keypad objects, input
+// comes in as a 16-bit key mask per lane.
+class Batch
+{
+private:
+    size_t lanes;
+    // lane count rounded up to BATCH_WIDTH, the stride of every array below
+    size_t stride;
+    bool avx2 = false;
+    // lane-major memory, one BATCH_RAM_PITCH slot per lane
+    std::vector<uint8_t> RAM;
+    // V[reg * stride + lane]
+    std::vector<uint8_t> V;
+    std::vector<uint16_t> PC;
+    std::vector<uint16_t> IC;
+    // STACK[level * stride + lane]
+    std::vector<uint16_t> STACK;
+    std::vector<int8_t> SP;
+    std::vector<uint8_t> DTIME;
+    std::vector<uint8_t> STIME;
+    std::vector<uint64_t> rng;
+    std::vector<uint16_t> keys;
+    // Fx0A parked the lane until a key goes down, the key lands in V[wait_reg]
+    std::vector<uint8_t> waiting;
+    std::vector<uint8_t> wait_reg;
+    // 0xFF for real lanes, 0 for padding
+    std::vector<uint8_t> live;
+    // fb[row * stride + lane], packed like a low-res Framebuffer plane
+    std::vector<uint64_t> fb;
+    // the loaded ROM and font, what every lane holds until it stores
+    uint8_t image[RAM_SIZE] = {0};
+    // addresses some lane has stored to, only these are read from the lane
+    bool written[RAM_SIZE] = {false};
+    // emulated time, shared by every lane
+    uint64_t cycles = 0;
+    uint64_t ipf = 10;
+    uint64_t next_tick = 10;
+    void step();
+    void step_lane(size_t lane);
+    uint16_t fetch_lane(size_t lane);
+    uint8_t read(size_t lane, uint16_t addr);
+    void tick_timers();
+    uint8_t random_byte(size_t lane);
+#ifdef BATCH_AVX2
+    uint32_t pick_leader(size_t base, uint32_t alive);
+    void step_avx2();
+#endif
+public:
+    // instructions run for lanes together, and one at a time
+    uint64_t vector_steps = 0;
+    uint64_t lane_steps = 0;
+    Batch(size_t count);
+    size_t size();
+    void load_ROM(char const *filename);
+    void seed(size_t lane, uint64_t value);
+    // the lane's input poll, between frames as in CHIP8::run_frame: a key
+    // that goes down releases an Fx0A wait, a key already held doesn't
+    void set_keys(size_t lane, uint16_t mask);
+    void set_speed(uint64_t instructions_per_frame);
+    // runs every lane for the same number of instructions
+    uint64_t run(uint64_t instructions);
+    void run_frame();
+    uint64_t cycle_count();
+    Framebuffer framebuffer(size_t lane);
+};
+
+#endif // BATCH_H
@@ -1,15 +1,128 @@
 #include "CHIP8.h"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include "JIT.h"
+#include "Trace.h"
+#include "Profile.h"
 
-CHIP8::CHIP8(bool dbg) : gen(rd()), rnd(std::uniform_int_distribution<>(0, 0xFF))
+CHIP8::CHIP8(bool dbg, std::unique_ptr<Display> dsp, std::unique_ptr<Keypad> kpd)
+    : display(std::move(dsp)), keypad(std::move(kpd))
 {
     debug = dbg;
-    gen.seed(time(NULL));
+    std::random_device rd;
+    seed(static_cast<uint64_t>(rd()) << 32 | rd());
 
-    display = std::make_unique<Display>();
-    keypad = std::make_unique<Keypad>();
     PC = ROM_START;
+    IC = 0;
     SP = -1;
     std::fill(RAM, RAM + RAM_SIZE, 0);
+    std::fill(V, V + REGISTER_COUNT, 0);
+    std::fill(STACK, STACK + STACK_HEIGHT, 0);
+    use_quirks(QuirkProfile::MODERN);
+#ifdef CHIP8_PROFILE
+    profile = std::make_unique<Profile>();
+#endif
+}
+
+CHIP8::~CHIP8() = default;
+
+// the jit is only built when first asked for, and quietly stays off on
+// hosts where it can't run
+void CHIP8::set_engine(Engine e)
+{
+    engine = e;
+    if (engine != Engine::INTERPRETER && variant != Variant::CHIP8)
+    {
+        std::cout << "jit and threaded dispatch only run CHIP-8, using the interpreter\n";
+        engine = Engine::INTERPRETER;
+    }
+    if (engine == Engine::JIT && jit == nullptr)
+    {
+        jit = std::make_unique<JIT>(*this);
+    }
+    if (engine == Engine::JIT && !jit->available())
+    {
+        std::cout << "jit not available, using the interpreter\n";
+        engine = Engine::INTERPRETER;
+    }
+    update_stepping();
+}
+
+void CHIP8::set_variant(Variant v)
+{
+    variant = v;
+    ram_mask = variant == Variant::XOCHIP ? XO_RAM_SIZE - 1 : RAM_SIZE - 1;
+    // XO-CHIP's memory starts as a copy of RAM and goes back into it
+    if (variant == Variant::XOCHIP && XO_RAM.empty())
+    {
+        XO_RAM.assign(RAM, RAM + RAM_SIZE);
+        XO_RAM.resize(XO_RAM_SIZE, 0);
+        XO_OPS = std::make_unique<Op[]>(XO_RAM_SIZE);
+    }
+    else if (variant != Variant::XOCHIP && !XO_RAM.empty())
+    {
+        std::copy(XO_RAM.begin(), XO_RAM.begin() + RAM_SIZE, RAM);
+        std::vector<uint8_t>().swap(XO_RAM);
+        XO_OPS.reset();
+    }
+    map_memory();
+    set_engine(engine);
+    drop_decoded();
+    load_fonts();
+}
+
+// RAM and OPS, unless XO-CHIP's memory is allocated
+void CHIP8::map_memory()
+{
+    mem = XO_RAM.empty() ? RAM : XO_RAM.data();
+    ops = XO_OPS == nullptr ? OPS : XO_OPS.get();
+}
+
+// only the variant's addresses have anything decoded
+void CHIP8::drop_decoded()
+{
+    std::fill(ops, ops + ram_mask + 1, Op());
+}
+
+// profiles come from movies, arguments and other outside bytes, and index
+// tables, so this is the one place they are checked
+void CHIP8::set_quirks(QuirkProfile profile)
+{
+    if (static_cast<unsigned>(profile) >= QUIRK_PROFILES)
+    {
+        std::cout << "unknown quirk profile " << static_cast<unsigned>(profile) << "\n";
+        exit(1);
+    }
+    use_quirks(profile);
+    quirks_chosen = true;
+}
+
+QuirkProfile CHIP8::quirk_profile()
+{
+    return quirk;
+}
+
+// handlers are picked at decode time and the jit bakes the quirks into its
+// code, so both start over when the profile changes
+void CHIP8::use_quirks(QuirkProfile profile)
+{
+    static const QuirkOps *const handlers[QUIRK_PROFILES] = {
+        quirk_handlers<QuirkProfile::MODERN>(), quirk_handlers<QuirkProfile::VIP>(),
+        quirk_handlers<QuirkProfile::CHIP48>(), quirk_handlers<QuirkProfile::SCHIP>()};
+    assert(static_cast<unsigned>(profile) < QUIRK_PROFILES);
+    if (quirk_ops != nullptr && profile == quirk)
+    {
+        return;
+    }
+    quirk = profile;
+    quirks = QUIRKS[static_cast<int>(profile)];
+    quirk_ops = handlers[static_cast<int>(profile)];
+    drop_decoded();
+    if (jit != nullptr)
+    {
+        jit->flush();
+    }
 }
 
 void CHIP8::load_ROM(char const *filename)
@@ -18,95 +131,794 @@ void CHIP8::load_ROM(char const *filename)
     rom.open(filename, std::ios::binary | std::ios::in);
     if (!rom.is_open())
     {
-        std::cout << "cannot open file\n";
-        exit(1);
+        std::cout << "cannot open file\n";
+        exit(1);
+    }
+    // get length of rom
+    rom.seekg(0, std::ios::end);
+    size_t length = rom.tellg();
+    rom.seekg(0, std::ios::beg);
+    // read file into buffer
+    auto buf = std::make_unique<uint8_t[]>(length);
+    rom.read(reinterpret_cast<char *>(buf.get()), length);
+    rom.close();
+    if (rom.is_open())
+    {
+        std::cout << "failed to close file\n";
+        exit(1);
+    }
+    load_ROM(buf.get(), length);
+}
+
+void CHIP8::load_ROM(const uint8_t *data, size_t length)
+{
+    if (length > ram_mask + 1u - ROM_START)
+    {
+        std::cout << "rom too large\n";
+        exit(1);
+    }
+    // only decoded code the image changes is dropped, so a reload is cheap
+    write_memory(ROM_START, data, length);
+    sha1(data, length, rom_sha1);
+    QuirkProfile known = QuirkProfile::MODERN;
+    if (!quirks_chosen)
+    {
+        find_quirks(rom_sha1, known);
+        use_quirks(known);
+    }
+    load_fonts();
+}
+
+const uint8_t *CHIP8::rom_digest()
+{
+    return rom_sha1;
+}
+
+// the big font only goes in for the variants that have Fx30
+void CHIP8::load_fonts()
+{
+    write_memory(FONTSET_START, FONTSET, FONTSET_SIZE);
+    if (variant != Variant::CHIP8)
+    {
+        write_memory(BIGFONT_START, BIGFONT, BIGFONT_SIZE);
+    }
+}
+
+void CHIP8::print_RAM()
+{
+    for (int addr = 0; addr <= ram_mask; ++addr)
+    {
+        std::cout << mem[addr];
+    }
+}
+
+const Framebuffer &CHIP8::framebuffer()
+{
+    return fb;
+}
+
+uint16_t CHIP8::fetch()
+{
+    uint16_t instruction = mem[PC & ram_mask] << 8 | mem[(PC + 1) & ram_mask];
+    PC += 2;
+    return instruction;
+}
+
+// same as fetch, but only decodes the instruction the first time it runs
+const Op &CHIP8::fetch_op()
+{
+    Op &op = ops[PC & ram_mask];
+    if (op.handler == nullptr)
+    {
+        decode_at(op, PC);
+    }
+    PC += 2;
+    return op;
+}
+
+// kept out of fetch_op so the hit path stays small enough to inline. a
+// breakpoint is decoded as a trap, and never fused into the word before it
+void CHIP8::decode_at(Op &op, uint16_t addr)
+{
+    op = decode(mem[addr & ram_mask] << 8 | mem[(addr + 1) & ram_mask]);
+    if (debugger != nullptr && debugger->breaks(addr & ram_mask))
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.breakpoint(o); };
+        op.count = 0;
+    }
+    else if (debugger == nullptr || !debugger->breaks((addr + 2) & ram_mask))
+    {
+        fuse(op, mem[(addr + 2) & ram_mask] << 8 | mem[(addr + 3) & ram_mask]);
+    }
+#ifdef THREADED_DISPATCH
+    op.label = thread_label(op);
+#endif
+}
+
+// a write to addr changes the instructions starting at addr and addr - 1,
+// and the superinstructions two bytes before those that cover them
+void CHIP8::invalidate(uint16_t addr)
+{
+    ops[addr & ram_mask].handler = nullptr;
+    ops[(addr - 1) & ram_mask].handler = nullptr;
+    ops[(addr - 2) & ram_mask].handler = nullptr;
+    ops[(addr - 3) & ram_mask].handler = nullptr;
+    if (jit != nullptr)
+    {
+        jit->invalidate(addr);
+    }
+}
+
+// runs exactly the given number of instructions on the selected engine
+uint64_t CHIP8::run_engine(uint64_t instructions)
+{
+    if (stepping)
+    {
+        return trace != nullptr ? run_traced(instructions) : run_debugged(instructions);
+    }
+#ifdef THREADED_DISPATCH
+    if (engine == Engine::THREADED)
+    {
+        return run_threaded(instructions);
+    }
+#endif
+    // without computed goto the threaded engine is this cached interpreter
+    uint64_t done = 0;
+    while (done < instructions)
+    {
+        if (engine == Engine::JIT)
+        {
+            uint64_t ran = jit->run(instructions - done);
+            if (ran > 0)
+            {
+                done += ran;
+                continue;
+            }
+        }
+        const Op &op = fetch_op();
+        if (op.count == 1)
+        {
+            execute(op);
+            ++done;
+            continue;
+        }
+        // a superinstruction that would run past the budget only runs its first half
+        if (instructions - done < op.count)
+        {
+            execute(decode(op.instruction));
+            ++done;
+            continue;
+        }
+#ifdef CHIP8_PROFILE
+        uint16_t second = PC & ram_mask;
+#endif
+        execute(op);
+        // a breakpoint retires nothing and leaves the machine in front of it
+        if (retired == 0)
+        {
+            return done;
+        }
+        if (retired > 1)
+        {
+            PROFILE(hit(second, op.next));
+            fused += retired;
+        }
+        done += retired;
+        // a skip over a jump that went round is how delay loops close, so
+        // this is where one entered mid-budget gets noticed
+        if (retired > 1 && (op.instruction >> 12) == 0x3)
+        {
+            done += skip_idle(instructions - done);
+        }
+    }
+    return done;
+}
+
+// tracing always goes through the interpreter so every instruction is seen
+uint64_t CHIP8::run_traced(uint64_t instructions)
+{
+    for (uint64_t done = 0; done < instructions; ++done)
+    {
+        uint16_t pc = PC;
+        uint8_t before[REGISTER_COUNT];
+        std::memcpy(before, V, REGISTER_COUNT);
+        // superinstructions are split back up so each half gets its record
+        Op op = fetch_op();
+        if (op.count > 1)
+        {
+            op = decode(op.instruction);
+        }
+        execute(op);
+        if (op.count == 0 && retired == 0)
+        {
+            return done;
+        }
+        TraceRecord record = {cycles + done, pc, op.instruction, IC, 0, {0}};
+        for (int i = 0; i < REGISTER_COUNT; ++i)
+        {
+            record.changed |= (V[i] != before[i]) << i;
+        }
+        std::memcpy(record.V, V, REGISTER_COUNT);
+        trace->record(record);
+    }
+    return instructions;
+}
+
+// one instruction at a time, superinstructions split, with the registers
+// compared after each one. breakpoints still come from the decoded traps.
+uint64_t CHIP8::run_debugged(uint64_t instructions)
+{
+    for (uint64_t done = 0; done < instructions; ++done)
+    {
+        uint8_t before[REGISTER_COUNT];
+        std::memcpy(before, V, REGISTER_COUNT);
+        uint16_t ic = IC;
+        Op op = fetch_op();
+        if (op.count > 1)
+        {
+            op = decode(op.instruction);
+        }
+        execute(op);
+        if (op.count == 0 && retired == 0)
+        {
+            return done;
+        }
+        uint32_t changed = IC != ic ? 1 << WATCH_I : 0;
+        for (int i = 0; i < REGISTER_COUNT; ++i)
+        {
+            changed |= (V[i] != before[i]) << i;
+        }
+        changed &= debugger->registers;
+        if (changed != 0 && debugger->reason == StopReason::NONE)
+        {
+            stop(StopReason::REGISTER, __builtin_ctz(changed));
+        }
+        if (debugger->reason != StopReason::NONE)
+        {
+            return done + 1;
+        }
+    }
+    return instructions;
+}
+
+MachineState CHIP8::snapshot()
+{
+    return *this;
+}
+
+void CHIP8::restore(const MachineState &state)
+{
+    if (state.XO_RAM.size() != XO_RAM.size())
+    {
+        std::cout << "state is for another instruction set\n";
+        exit(1);
+    }
+    const uint8_t *from = state.XO_RAM.empty() ? state.RAM : state.XO_RAM.data();
+    // compare a word at a time, only dropping decoded code that changed
+    for (int addr = 0; addr <= ram_mask; addr += 8)
+    {
+        uint64_t a, b;
+        std::memcpy(&a, mem + addr, 8);
+        std::memcpy(&b, from + addr, 8);
+        if (a == b)
+        {
+            continue;
+        }
+        for (int i = addr; i < addr + 8; ++i)
+        {
+            if (mem[i] != from[i])
+            {
+                invalidate(i);
+            }
+        }
+    }
+    static_cast<MachineState &>(*this) = state;
+    map_memory();
+}
+
+void CHIP8::save_state(char const *filename)
+{
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open())
+    {
+        std::cout << "cannot open file\n";
+        exit(1);
+    }
+    MachineState state = snapshot();
+    StateHeader header = {STATE_MAGIC, STATE_VERSION, sizeof(MachineCore), static_cast<uint32_t>(state.XO_RAM.size())};
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(static_cast<MachineCore *>(&state)), sizeof(MachineCore));
+    out.write(reinterpret_cast<const char *>(state.XO_RAM.data()), state.XO_RAM.size());
+}
+
+void CHIP8::load_state(char const *filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open())
+    {
+        std::cout << "cannot open file\n";
+        exit(1);
+    }
+    StateHeader header;
+    auto state = std::make_unique<MachineState>();
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    in.read(reinterpret_cast<char *>(static_cast<MachineCore *>(state.get())), sizeof(MachineCore));
+    if (!in || header.magic != STATE_MAGIC || header.version != STATE_VERSION || header.size != sizeof(MachineCore) ||
+        (header.xo_size != 0 && header.xo_size != XO_RAM_SIZE))
+    {
+        std::cout << "not a save state for this version\n";
+        exit(1);
+    }
+    state->XO_RAM.resize(header.xo_size);
+    in.read(reinterpret_cast<char *>(state->XO_RAM.data()), header.xo_size);
+    if (!in)
+    {
+        std::cout << "not a save state for this version\n";
+        exit(1);
+    }
+    // the fields that index arrays, anything else is just a machine
+    if (state->SP < -1 || state->SP >= STACK_HEIGHT || state->wait_reg >= REGISTER_COUNT)
+    {
+        std::cout << "save state is corrupt\n";
+        exit(1);
+    }
+    restore(*state);
+}
+
+void CHIP8::start_trace(const char *filename)
+{
+    trace = std::make_unique<Trace>(filename);
+    update_stepping();
+}
+
+void CHIP8::stop_trace()
+{
+    trace.reset();
+    update_stepping();
+}
+
+void CHIP8::attach_debugger()
+{
+    debugger = std::make_unique<Debugger>();
+}
+
+// drops the traps along with the debugger
+void CHIP8::detach_debugger()
+{
+    debugger.reset();
+    drop_decoded();
+    if (jit != nullptr)
+    {
+        jit->flush();
+    }
+    update_stepping();
+}
+
+// the decoded op and any block covering addr are dropped, so the trap goes
+// in (or comes out) the next time the address runs
+void CHIP8::set_breakpoint(uint16_t addr, bool on)
+{
+    debugger->set(addr & ram_mask, on);
+    invalidate(addr);
+    update_stepping();
+}
+
+void CHIP8::set_watchpoint(uint16_t addr, uint16_t length, bool on)
+{
+    auto &watches = debugger->watches;
+    auto w = std::find(watches.begin(), watches.end(), std::make_pair(addr, length));
+    if (on && w == watches.end())
+    {
+        watches.push_back({addr, length});
+    }
+    else if (!on && w != watches.end())
+    {
+        watches.erase(w);
+    }
+    update_stepping();
+}
+
+void CHIP8::watch_registers(uint32_t mask)
+{
+    debugger->registers = mask;
+    update_stepping();
+}
+
+uint32_t CHIP8::watched_registers()
+{
+    return debugger->registers;
+}
+
+void CHIP8::update_stepping()
+{
+    stepping = trace != nullptr ||
+               (debugger != nullptr &&
+                (debugger->registers != 0 || (engine == Engine::THREADED && debugger->armed())));
+}
+
+StopReason CHIP8::stop_reason()
+{
+    return debugger->reason;
+}
+
+uint16_t CHIP8::stop_address()
+{
+    return debugger->address;
+}
+
+void CHIP8::resume()
+{
+    if (debugger->stop_at >= 0)
+    {
+        uint16_t addr = debugger->stop_at;
+        debugger->stop_at = -1;
+        invalidate(addr);
+    }
+    debugger->reason = StopReason::NONE;
+    debugger->resume_at = debugger->breaks(PC & ram_mask) ? PC & ram_mask : -1;
+}
+
+DebugRegisters CHIP8::registers()
+{
+    DebugRegisters regs;
+    std::memcpy(regs.V, V, REGISTER_COUNT);
+    regs.I = IC;
+    regs.PC = PC;
+    regs.SP = SP;
+    regs.DT = DTIME;
+    regs.ST = STIME;
+    return regs;
+}
+
+void CHIP8::set_registers(const DebugRegisters &regs)
+{
+    std::memcpy(V, regs.V, REGISTER_COUNT);
+    IC = regs.I;
+    PC = regs.PC;
+    SP = regs.SP;
+    DTIME = regs.DT;
+    STIME = regs.ST;
+}
+
+const uint8_t *CHIP8::memory()
+{
+    return mem;
+}
+
+size_t CHIP8::memory_size()
+{
+    return ram_mask + 1u;
+}
+
+void CHIP8::write_memory(uint16_t addr, const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length && addr + i <= ram_mask; ++i)
+    {
+        if (mem[addr + i] != data[i])
+        {
+            mem[addr + i] = data[i];
+            invalidate(addr + i);
+        }
+    }
+}
+
+// the trap decoded in place of an instruction with a breakpoint on it, PC
+// is already past the instruction
+void CHIP8::breakpoint(const Op &op)
+{
+    uint16_t pc = (PC - 2) & ram_mask;
+    if (pc == debugger->resume_at && pc != debugger->stop_at)
+    {
+        debugger->resume_at = -1;
+        Op real = decode(op.instruction);
+        real.handler(*this, real);
+        retired = 1;
+        return;
+    }
+    if (pc == debugger->stop_at)
+    {
+        // the watchpoint already gave the reason
+        debugger->stop_at = -1;
+        invalidate(pc);
+    }
+    else
+    {
+        debugger->reason = StopReason::BREAKPOINT;
+        debugger->address = pc;
+    }
+    PC -= 2;
+    retired = 0;
+}
+
+// a watchpoint hit during an instruction. the machine stops once it's
+// done, on a trap in front of the next one, so every engine stops the same way
+void CHIP8::stop(StopReason reason, uint16_t address)
+{
+    debugger->reason = reason;
+    debugger->address = address;
+    debugger->stop_at = PC & ram_mask;
+    invalidate(PC);
+}
+
+// after a store to memory
+void CHIP8::stored(uint16_t addr, uint16_t length)
+{
+    int32_t hit = debugger->watched(addr & ram_mask, length);
+    if (hit >= 0 && debugger->reason == StopReason::NONE)
+    {
+        stop(StopReason::WATCHPOINT, hit);
+    }
+}
+
+// timers tick every ipf emulated instructions, never from host time, and
+// every engine stops exactly on the tick so all of them see the same DTIME
+uint64_t CHIP8::run(uint64_t instructions)
+{
+    uint64_t done = 0;
+    while (done < instructions)
+    {
+        uint64_t chunk = std::min(instructions - done, next_tick - cycles);
+        // a machine parked on Fx0A or spinning in an idle loop skips ahead
+        // to the next tick
+        uint64_t ran = chunk;
+        if (waiting)
+        {
+            idle += chunk;
+        }
+        else
+        {
+            ran = skip_idle(chunk);
+            ran += run_engine(chunk - ran);
+        }
+        done += ran;
+        cycles += ran;
+        // only a debugger stop comes back short
+        if (ran < chunk)
+        {
+            break;
+        }
+        if (cycles >= next_tick)
+        {
+            tick_timers();
+            next_tick += ipf;
+        }
+    }
+    return done;
+}
+
+// a polling loop with no side effects can't leave before the next timer
+// tick or input poll, so whole trips round it are skipped at once: Fx07
+// 3x00 1NNN on the delay timer, Ex9E/ExA1 over a jump back, or a jump to
+// itself. the machine ends up exactly as if the trips had run.
+uint64_t CHIP8::skip_idle(uint64_t budget)
+{
+    if (stepping)
+    {
+        return 0;
+    }
+    auto word = [this](uint16_t addr) { return static_cast<uint16_t>(mem[addr & ram_mask] << 8 | mem[(addr + 1) & ram_mask]); };
+    uint16_t pc = PC & ram_mask;
+    uint16_t head;
+    switch (word(pc) >> 12)
+    {
+    case 0x1:
+        head = word(pc) & NNN;
+        break;
+    case 0x3:
+        head = pc - 2;
+        break;
+    case 0xE:
+    case 0xF:
+        head = pc;
+        break;
+    default:
+        return 0;
+    }
+    // where the jump back sits, so the loop is 1 to 3 instructions long
+    uint16_t tail = head;
+    while (tail < head + 6 && word(tail) >> 12 != 0x1)
+    {
+        tail += 2;
     }
-    // get length of rom
-    rom.seekg(0, std::ios::end);
-    ulong length = rom.tellg();
-    rom.seekg(0, std::ios::beg);
-    // read file into buffer
-    auto buf = std::make_unique<char[]>(length);
-    rom.read(buf.get(), length);
-    // set ram from buffer
-    for (int i = 0; i < length; ++i)
+    if (head > NNN || pc < head || pc > tail || word(tail) != (0x1000 | head))
     {
-        RAM[ROM_START + i] = buf[i];
+        return 0;
     }
-    rom.close();
-    if (rom.is_open())
+    // a loop with a breakpoint in it has to run to reach it
+    if (debugger != nullptr && debugger->breaks(head, tail))
     {
-        std::cout << "failed to close file\n";
-        exit(1);
+        return 0;
     }
-
-    // load fontset into memory
-    for (int i = 0; i < FONTSET_SIZE; ++i)
+    uint16_t first = word(head);
+    uint8_t x = first >> 8 & 0xF;
+    uint8_t length = (tail - head) / 2 + 1;
+    if (length == 2 && (first & 0xF0FF) == 0xE09E)
+    {
+        if (keypad->getKey(V[x]))
+        {
+            return 0;
+        }
+    }
+    else if (length == 2 && (first & 0xF0FF) == 0xE0A1)
     {
-        RAM[FONTSET_START + i] = FONTSET[i];
+        if (!keypad->getKey(V[x]))
+        {
+            return 0;
+        }
+    }
+    else if (length == 3 && (first & 0xF0FF) == 0xF007 && word(head + 2) == (0x3000 | x << 8))
+    {
+        // entered at the SE, Vx still holds the value from before
+        if (DTIME == 0 || (pc != head && V[x] == 0))
+        {
+            return 0;
+        }
+    }
+    else if (length != 1)
+    {
+        return 0;
     }
+    uint64_t trips = budget / length;
+    if (trips == 0)
+    {
+        return 0;
+    }
+    if (length == 3)
+    {
+        V[x] = DTIME;
+    }
+    idle += trips * length;
+#ifdef CHIP8_PROFILE
+    for (uint16_t addr = head; addr <= tail; addr += 2)
+    {
+        profile->hit(addr, word(addr), trips);
+    }
+#endif
+    return trips * length;
 }
 
-void CHIP8::print_RAM()
+void CHIP8::set_speed(uint64_t instructions_per_frame)
 {
-    for (const uint8_t &b : RAM)
-    {
-        std::cout << b;
-    }
+    ipf = instructions_per_frame;
+    next_tick = cycles + ipf;
 }
 
-uint16_t CHIP8::fetch()
+void CHIP8::seed(uint64_t value)
 {
-    uint16_t instruction = RAM[PC] << 8 | RAM[PC+1];
-    PC += 2;
-    update_timers();
-    return instruction;
+    // xorshift must never hold zero
+    rng = value != 0 ? value : 0x9E3779B97F4A7C15ULL;
+}
+
+// xorshift64*, top byte of the product
+uint8_t CHIP8::random_byte()
+{
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return (rng * 0x2545F4914F6CDD1DULL) >> 56;
+}
+
+uint64_t CHIP8::cycle_count()
+{
+    return cycles;
+}
+
+uint64_t CHIP8::fused_count()
+{
+    return fused;
+}
+
+uint64_t CHIP8::idle_count()
+{
+    return idle;
 }
 
-void CHIP8::update_timers()
+// called once per emulated 60 Hz frame
+void CHIP8::tick_timers()
 {
+    PROFILE(end_frame());
+    if (audio != nullptr)
+    {
+        audio->frame(STIME > 0);
+    }
     if (DTIME > 0)
     {
-        uint64_t t = SDL_GetTicks();
-        DTIME = DTIME - ((t - dtStart) / TPH);
-        if (DTIME > 0xFF)
-        {
-            DTIME = 0;
-        }
+        --DTIME;
     }
     if (STIME > 0)
     {
-        uint64_t t = SDL_GetTicks();
-        STIME = STIME - ((t - stStart) / TPH);
-        if (STIME > 0xFF)
-        {
-            STIME = 0;
-        }
+        --STIME;
     }
 }
 
-void CHIP8::step() {
-    if(keypad->handleEvents() == 0xFF) {
+// input is sampled once here, before the frame's instructions run
+void CHIP8::run_frame(bool present)
+{
+    poll_input(keypad->handleEvents());
+    run(next_tick - cycles);
+    if (present)
+    {
+        display->draw(fb);
+    }
+}
+
+bool CHIP8::waiting_for_key()
+{
+    return waiting;
+}
+
+void CHIP8::wait_input(uint32_t timeout)
+{
+    poll_input(keypad->waitEvents(timeout));
+}
+
+// a key going down releases a pending Fx0A, which then completes
+void CHIP8::poll_input(uint8_t key)
+{
+    if (key == QUIT_KEY)
+    {
         clean_up();
         exit(1);
     }
-    decode_and_execute(fetch());
-    display->draw();
+    if (waiting && key != NO_KEY)
+    {
+        V[wait_reg] = key;
+        waiting = false;
+        PC += 2;
+    }
+}
+
+// one instruction, input is left to run_frame
+void CHIP8::step() {
+    run(1);
+    display->draw(fb);
+}
+
+void CHIP8::set_audio(std::unique_ptr<Audio> a)
+{
+    audio = std::move(a);
 }
 
 void CHIP8::clean_up() {
+    // closes the device, or finishes the WAV file
+    audio.reset();
     display->destroy_window();
-    SDL_Quit();
+    stop_trace();
+#ifdef CHIP8_PROFILE
+    profile->report(std::cout, mem, ram_mask);
+#endif
 }
 void CHIP8::decode_and_execute(uint16_t instruction)
 {
-    std::cout << "PC: " << std::hex << PC << " Instruction: " << std::hex << instruction << "\n";
+    execute(decode(instruction));
+}
+
+void CHIP8::execute(const Op &op)
+{
+    LOG("PC: " << std::hex << PC << " Instruction: " << std::hex << op.instruction << "\n");
+    PROFILE(hit((PC - 2) & ram_mask, op.instruction));
+    op.handler(*this, op);
+}
+
+Op CHIP8::decode(uint16_t instruction)
+{
     uint8_t first_nibble = (instruction >> 12) & 0xF; // XXXXoooooooooooo
     uint8_t second_nibble = (instruction >> 8) & 0xF; // ooooXXXXoooooooo
     uint8_t third_nibble = (instruction >> 4) & 0xF;  // ooooooooXXXXoooo
     uint8_t fourth_nibble = instruction & 0xF;
     uint8_t last_byte = (instruction & 0xFF);           // ooooooooXXXXXXXX
     uint16_t last_three_nibbles = instruction & 0x0FFF; // ooooXXXXXXXXXXXX
+    Op op;
+    op.instruction = instruction;
+    op.nnn = last_three_nibbles;
+    op.x = second_nibble;
+    op.y = third_nibble;
+    op.n = fourth_nibble;
+    op.kk = last_byte;
+    if (variant != Variant::CHIP8 && decode_extended(op))
+    {
+        return op;
+    }
     switch (first_nibble)
     {
     case 0x0:
@@ -114,50 +926,50 @@ void CHIP8::decode_and_execute(uint16_t instruction)
         switch (last_three_nibbles)
         {
         case 0x0EE:
-            RET();
+            op.handler = [](CHIP8 &c, const Op &o) { c.RET(); };
             break;
         case 0x0E0:
-            CLS();
+            op.handler = [](CHIP8 &c, const Op &o) { c.CLS(); };
             break;
         default:
-        if(debug) {
-        }
+            // 0NNN machine code routines are ignored
+            op.handler = [](CHIP8 &c, const Op &o) {};
         }
         break;
     }
     case 0x1:
     {
-        JP(last_three_nibbles);
+        op.handler = [](CHIP8 &c, const Op &o) { c.JP(o.nnn); };
         break;
     }
     case 0x2:
     {
-        CALL(last_three_nibbles);
+        op.handler = [](CHIP8 &c, const Op &o) { c.CALL(o.nnn); };
         break;
     }
     case 0x3:
     {
-        SE(second_nibble, last_byte);
+        op.handler = [](CHIP8 &c, const Op &o) { c.SE(o.x, o.kk); };
         break;
     }
     case 0x4:
     {
-        SNE(second_nibble, last_byte);
+        op.handler = [](CHIP8 &c, const Op &o) { c.SNE(o.x, o.kk); };
         break;
     }
     case 0x5:
     {
-        SER(second_nibble, third_nibble);
+        op.handler = [](CHIP8 &c, const Op &o) { c.SER(o.x, o.y); };
         break;
     }
     case 0x6:
     {
-        LD(second_nibble, last_byte);
+        op.handler = [](CHIP8 &c, const Op &o) { c.LD(o.x, o.kk); };
         break;
     }
     case 0x7:
     {
-        ADD(second_nibble, last_byte);
+        op.handler = [](CHIP8 &c, const Op &o) { c.ADD(o.x, o.kk); };
         break;
     }
     case 0x8:
@@ -166,80 +978,83 @@ void CHIP8::decode_and_execute(uint16_t instruction)
         {
         case 0x0:
         {
-            LDR(second_nibble, third_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.LDR(o.x, o.y); };
             break;
         }
         case 0x1:
         {
-            OR(second_nibble, third_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.OR(o.x, o.y); };
             break;
         }
         case 0x2:
         {
-            AND(second_nibble, third_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.AND(o.x, o.y); };
             break;
         }
         case 0x3:
         {
-            XOR(second_nibble, third_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.XOR(o.x, o.y); };
             break;
         }
         case 0x4:
         {
-            ADDC(second_nibble, third_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.ADDC(o.x, o.y); };
             break;
         }
         case 0x5:
         {
-            SUB(second_nibble, third_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.SUB(o.x, o.y); };
             break;
         }
         case 0x6:
         {
-            SHR(second_nibble, third_nibble);
+            op.handler = quirk_ops->shr;
             break;
         }
         case 0x7:
         {
-            SUBN(second_nibble, third_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.SUBN(o.x, o.y); };
             break;
         }
         case 0xE:
         {
-            SHL(second_nibble, third_nibble);
+            op.handler = quirk_ops->shl;
             break;
         }
         default:
         {
-            std::cout << "reached 0x8___ default\n";
-            exit(1);
+            op.handler = [](CHIP8 &c, const Op &o)
+            {
+                std::cout << "reached 0x8___ default\n";
+                exit(1);
+            };
         }
         }
         break;
     }
     case 0x9:
     {
-        SNER(second_nibble, third_nibble);
+        op.handler = [](CHIP8 &c, const Op &o) { c.SNER(o.x, o.y); };
         break;
     }
     case 0xA:
     {
-        LDI(last_three_nibbles);
+        op.handler = [](CHIP8 &c, const Op &o) { c.LDI(o.nnn); };
         break;
     }
     case 0xB:
     {
-        JPP(last_three_nibbles);
+        op.handler = quirk_ops->jpp;
         break;
     }
     case 0xC:
     {
-        RND(second_nibble, last_byte);
+        op.handler = [](CHIP8 &c, const Op &o) { c.RND(o.x, o.kk); };
         break;
     }
     case 0xD:
     {
-        DRW(second_nibble, third_nibble, fourth_nibble);
+        op.handler = [](CHIP8 &c, const Op &o) { c.DRW(o.x, o.y, o.n); };
         break;
     }
     case 0xE:
@@ -248,18 +1063,21 @@ void CHIP8::decode_and_execute(uint16_t instruction)
         {
         case 0x9E:
         {
-            SKP(second_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.SKP(o.x); };
             break;
         }
         case 0xA1:
         {
-            SKNP(second_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.SKNP(o.x); };
             break;
         }
         default:
         {
-            std::cout << "0xE___ default\n";
-            exit(1);
+            op.handler = [](CHIP8 &c, const Op &o)
+            {
+                std::cout << "0xE___ default\n";
+                exit(1);
+            };
         }
         }
         break;
@@ -270,74 +1088,238 @@ void CHIP8::decode_and_execute(uint16_t instruction)
         {
         case 0x07:
         {
-            LDT(second_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.LDT(o.x); };
             break;
         }
         case 0x0A:
         {
-            LDK(second_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.LDK(o.x); };
             break;
         }
         case 0x15:
         {
-            LDDT(second_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.LDDT(o.x); };
             break;
         }
         case 0x18:
         {
-            LDST(second_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.LDST(o.x); };
             break;
         }
         case 0x1E:
         {
-            ADDI(second_nibble);
+            op.handler = quirk_ops->addi;
             break;
         }
         case 0x29:
         {
-            LDF(second_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.LDF(o.x); };
             break;
         }
         case 0x33:
         {
-            LDB(second_nibble);
+            op.handler = [](CHIP8 &c, const Op &o) { c.LDB(o.x); };
             break;
         }
         case 0x55:
         {
-            RTM(second_nibble);
+            op.handler = quirk_ops->rtm;
             break;
         }
         case 0x65:
         {
-            MTR(second_nibble);
+            op.handler = quirk_ops->mtr;
             break;
         }
         default:
         {
-            std::cout << "0xF___ default\n";
-            exit(1);
+            op.handler = [](CHIP8 &c, const Op &o)
+            {
+                std::cout << "0xF___ default\n";
+                exit(1);
+            };
         }
         }
         break;
     }
     default:
     {
-        std::cout << "empty instruction reached bottom\n";
-        exit(1);
+        op.handler = [](CHIP8 &c, const Op &o)
+        {
+            std::cout << "empty instruction reached bottom\n";
+            exit(1);
+        };
     }
     }
+    return op;
 }
 
-void CHIP8::CLS()
+// SUPER-CHIP and XO-CHIP instructions, false leaves op to the CHIP-8 decoder
+bool CHIP8::decode_extended(Op &op)
+{
+    bool xo = variant == Variant::XOCHIP;
+    uint16_t instruction = op.instruction;
+    if ((instruction & 0xFFF0) == 0x00C0)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.SCD(o.n); };
+    }
+    else if (xo && (instruction & 0xFFF0) == 0x00D0)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.SCU(o.n); };
+    }
+    else if (instruction == 0x00FB)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.SCR(); };
+    }
+    else if (instruction == 0x00FC)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.SCL(); };
+    }
+    else if (instruction == 0x00FD)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.EXIT(); };
+    }
+    else if (instruction == 0x00FE)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.LOW(); };
+    }
+    else if (instruction == 0x00FF)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.HIGH(); };
+    }
+    else if (xo && (instruction & 0xF00F) == 0x5002)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.SRG(o.x, o.y); };
+    }
+    else if (xo && (instruction & 0xF00F) == 0x5003)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.LRG(o.x, o.y); };
+    }
+    else if (xo && instruction == 0xF000)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.LDIL(); };
+    }
+    else if (xo && (instruction & 0xF0FF) == 0xF001)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.PLANE(o.x); };
+    }
+    else if (xo && (instruction == 0xF002 || (instruction & 0xF0FF) == 0xF03A))
+    {
+        // audio pattern and pitch, the beeper keeps its square wave
+        op.handler = [](CHIP8 &c, const Op &o) {};
+    }
+    else if ((instruction & 0xF0FF) == 0xF030)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.LDHF(o.x); };
+    }
+    else if ((instruction & 0xF0FF) == 0xF075)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.SRPL(o.x); };
+    }
+    else if ((instruction & 0xF0FF) == 0xF085)
+    {
+        op.handler = [](CHIP8 &c, const Op &o) { c.LRPL(o.x); };
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// pairs that show up all over ROM code run as one superinstruction. the
+// second word keeps its own cache entry, so a jump or skip landing on it
+// still runs it alone, and no first half writes memory, so the second can't
+// change underneath it.
+void CHIP8::fuse(Op &op, uint16_t next)
 {
-    for (int row = 0; row < ROWS; ++row)
+    uint8_t first = op.instruction >> 12;
+    uint8_t second = next >> 12;
+    bool addi = (op.instruction & 0xF0FF) == 0xF01E;
+    OpHandler handler = nullptr;
+    if ((first == 0x6 || first == 0x7) && (second == 0x6 || second == 0x7))
+    {
+        // register setup, LD/ADD in any order
+        static const OpHandler loads[4] = {
+            [](CHIP8 &c, const Op &o) { c.LD(o.x, o.kk); c.LD(o.next >> 8 & 0xF, o.next & 0xFF); c.PC += 2; c.retired = 2; },
+            [](CHIP8 &c, const Op &o) { c.LD(o.x, o.kk); c.ADD(o.next >> 8 & 0xF, o.next & 0xFF); c.PC += 2; c.retired = 2; },
+            [](CHIP8 &c, const Op &o) { c.ADD(o.x, o.kk); c.LD(o.next >> 8 & 0xF, o.next & 0xFF); c.PC += 2; c.retired = 2; },
+            [](CHIP8 &c, const Op &o) { c.ADD(o.x, o.kk); c.ADD(o.next >> 8 & 0xF, o.next & 0xFF); c.PC += 2; c.retired = 2; }};
+        handler = loads[(first - 0x6) * 2 + second - 0x6];
+    }
+    else if (first == 0x3 && second == 0x1)
     {
-        for (int col = 0; col < COLS; ++col)
+        // a skipped jump retires only the skip
+        handler = [](CHIP8 &c, const Op &o)
         {
-            display->setPixel(row, col, false);
-        }
+            if (c.V[o.x] == o.kk)
+            {
+                c.PC += 2;
+                c.retired = 1;
+                return;
+            }
+            c.JP(o.next & NNN);
+            c.retired = 2;
+        };
+    }
+    else if (first == 0x4 && second == 0x1)
+    {
+        handler = [](CHIP8 &c, const Op &o)
+        {
+            if (c.V[o.x] != o.kk)
+            {
+                c.PC += 2;
+                c.retired = 1;
+                return;
+            }
+            c.JP(o.next & NNN);
+            c.retired = 2;
+        };
+    }
+    else if (first == 0xA && second == 0xD)
+    {
+        handler = [](CHIP8 &c, const Op &o)
+        {
+            c.LDI(o.nnn);
+            c.PC += 2;
+            c.DRW(o.next >> 8 & 0xF, o.next >> 4 & 0xF, o.next & 0xF);
+            c.retired = 2;
+        };
     }
+    else if (addi && second == 0xD)
+    {
+        handler = quirk_ops->addi_drw;
+    }
+    else if (addi && (next & 0xF0FF) == 0xF01E)
+    {
+        handler = quirk_ops->addi_addi;
+    }
+    else if (addi && (next & 0xF0FF) == 0xF055)
+    {
+        handler = quirk_ops->addi_rtm;
+    }
+    else if (addi && (next & 0xF0FF) == 0xF065)
+    {
+        handler = quirk_ops->addi_mtr;
+    }
+    if (handler != nullptr)
+    {
+        op.handler = handler;
+        op.next = next;
+        op.count = 2;
+    }
+}
+
+// skips the next instruction, XO-CHIP's F000 NNNN is four bytes long
+void CHIP8::skip()
+{
+    bool long_i = variant == Variant::XOCHIP && mem[PC & ram_mask] == 0xF0 && mem[(PC + 1) & ram_mask] == 0x00;
+    PC += long_i ? 4 : 2;
+}
+
+void CHIP8::CLS()
+{
+    fb.clear(planes);
 }
 
 void CHIP8::JP(uint16_t address)
@@ -349,50 +1331,62 @@ void CHIP8::JP(uint16_t address)
 
 void CHIP8::DRW(uint8_t x_reg, uint8_t y_reg, uint8_t n)
 {
+    if (variant != Variant::CHIP8)
+    {
+        draw_planes(x_reg, y_reg, n);
+        return;
+    }
     uint8_t x = V[x_reg] & (COLS - 1);
     uint8_t y = V[y_reg] & (ROWS - 1);
-    V[0xF] = 0;
-    for (uint8_t i = 0; i < n; ++i)
+    bool collision = false;
+    for (uint8_t i = 0; i < n && y + i < ROWS; ++i)
+    {
+        collision |= fb.drawRow(y + i, x, mem[(IC + i) & ram_mask]);
+    }
+    V[0xF] = collision ? 0x1 : 0x0;
+    PROFILE(draw(collision));
+}
+
+// n == 0 draws a 16x16 sprite. every selected plane takes its own sprite,
+// stored one after another from I, and each sprite row is a two-word xor
+void CHIP8::draw_planes(uint8_t x_reg, uint8_t y_reg, uint8_t n)
+{
+    uint8_t x = V[x_reg] & (fb.width() - 1);
+    uint8_t y = V[y_reg] & (fb.height() - 1);
+    bool wide = n == 0;
+    uint8_t height = wide ? 16 : n;
+    uint8_t pitch = wide ? 2 : 1;
+    uint16_t addr = IC;
+    bool collision = false;
+    for (uint8_t plane = 0; plane < PLANES; ++plane)
     {
-        uint8_t x = V[x_reg] & (COLS - 1);
-        uint8_t data = RAM[IC + i];
-        for (uint8_t j = 0; j < 8; ++j)
+        if (!(planes & (1 << plane)))
         {
-            bool d = display->getPixel(y, x);
-            if ((data >> 7 - j) & 0x1 == 1)
-            {
-                if (d)
-                {
-                    display->setPixel(y, x, false);
-                    V[0xF] = 0x1;
-                }
-                else
-                {
-                    display->setPixel(y, x, true);
-                }
-            }
-            x += 1;
-            if (x >= COLS)
-            {
-                break;
-            }
+            continue;
         }
-        y += 1;
-        if (y >= ROWS)
+        for (uint8_t i = 0; i < height && y + i < fb.height(); ++i)
         {
-            break;
+            uint16_t row = addr + i * pitch;
+            uint16_t sprite = mem[row & ram_mask] << 8;
+            if (wide)
+            {
+                sprite |= mem[(row + 1) & ram_mask];
+            }
+            collision |= fb.drawRow16(plane, y + i, x, sprite);
         }
+        addr += height * pitch;
     }
-    display->draw();
+    V[0xF] = collision ? 0x1 : 0x0;
+    PROFILE(draw(collision));
 }
 
 void CHIP8::RET()
 {
-    if (SP <= -1) {
+    if (SP <= -1 || SP >= STACK_HEIGHT) {
         std::cout << "nothing to return to\n";
         exit(1);
     }
-    std::cout << "SP:" << SP << " STACK[SP]: " << STACK[SP] << "\n";
+    LOG("SP:" << SP << " STACK[SP]: " << STACK[SP] << "\n");
     PC = STACK[SP];
     --SP;
     if (SP <= -2)
@@ -400,42 +1394,54 @@ void CHIP8::RET()
         std::cout << "nothing to return to\n";
         exit(1);
     }
-    std::cout << "new SP after ret: " << SP << " new PC: " << PC << "\n"; 
+    LOG("new SP after ret: " << SP << " new PC: " << PC << "\n");
 }
 
 void CHIP8::CALL(uint16_t addr)
 {
-    std::cout << "SP before:" << SP << "\n";
+    LOG("SP before:" << SP << "\n");
     ++SP;
-    std::cout << "SP after:" << SP << "\n";
+    LOG("SP after:" << SP << "\n");
     if (SP >= 16)
     {
         std::cout << "stack overflow\n";
         exit(1);
     }
     STACK[SP] = PC;
-    std::cout << "STACK[SP] CALL: " << STACK[SP] << "\n";
+    LOG("STACK[SP] CALL: " << STACK[SP] << "\n");
     PC = addr;
 }
 
 void CHIP8::SE(uint8_t reg, uint8_t byte)
 {
-    PC = V[reg] == byte ? (PC + 2) : PC;
+    if (V[reg] == byte)
+    {
+        skip();
+    }
 }
 
 void CHIP8::SNE(uint8_t x_reg, uint8_t byte)
 {
-    PC = V[x_reg] != byte ? (PC + 2) : PC;
+    if (V[x_reg] != byte)
+    {
+        skip();
+    }
 }
 
 void CHIP8::SER(uint8_t x_reg, uint8_t y_reg)
 {
-    PC = (V[x_reg] == V[y_reg]) ? (PC + 2) : PC;
+    if (V[x_reg] == V[y_reg])
+    {
+        skip();
+    }
 }
 
 void CHIP8::SNER(uint8_t x_reg, uint8_t y_reg)
 {
-    PC = (V[x_reg] != V[y_reg]) ? (PC + 2) : PC;
+    if (V[x_reg] != V[y_reg])
+    {
+        skip();
+    }
 }
 
 void CHIP8::LD(uint8_t reg, uint8_t byte)
@@ -489,23 +1495,26 @@ void CHIP8::SUBN(uint8_t x_reg, uint8_t y_reg)
     V[x_reg] = diff;
 }
 
+// the quirk tests below are on constants, each profile's build has none
+template <QuirkProfile P>
 void CHIP8::SHR(uint8_t x_reg, uint8_t y_reg)
 {
-    if (copy_on_shift == true)
+    if (QUIRKS[static_cast<int>(P)].shift_vy)
     {
         V[x_reg] = V[y_reg];
     }
-    V[0xF] = 0x01 ? (V[x_reg] & 0x01) : 0x00;
+    V[0xF] = V[x_reg] & 0x01;
     V[x_reg] = V[x_reg] >> 1;
 }
 
+template <QuirkProfile P>
 void CHIP8::SHL(uint8_t x_reg, uint8_t y_reg)
 {
-    if (copy_on_shift == true)
+    if (QUIRKS[static_cast<int>(P)].shift_vy)
     {
         V[x_reg] = V[y_reg];
     }
-    V[0xF] = 0x01 ? (V[x_reg] & 0b10000000) : 0x00;
+    V[0xF] = V[x_reg] >> 7;
     V[x_reg] = V[x_reg] << 1;
 }
 
@@ -514,10 +1523,11 @@ void CHIP8::LDI(uint16_t addr)
     IC = addr;
 }
 
+template <QuirkProfile P>
 void CHIP8::JPP(uint16_t addr)
 {
     uint8_t jmp_val;
-    if (jump_offset_quirk)
+    if (QUIRKS[static_cast<int>(P)].jump_vx)
     {
         uint8_t reg = (addr >> 8) & 0xF;
         jmp_val = V[reg];
@@ -531,14 +1541,14 @@ void CHIP8::JPP(uint16_t addr)
 
 void CHIP8::RND(uint8_t reg, uint8_t byte)
 {
-    V[reg] = rnd(gen) & byte;
+    V[reg] = random_byte() & byte;
 }
 
 void CHIP8::SKP(uint8_t reg)
 {
     if (keypad->getKey(V[reg]) == true)
     {
-        ++PC;
+        skip();
     }
 }
 
@@ -546,7 +1556,7 @@ void CHIP8::SKNP(uint8_t reg)
 {
     if (keypad->getKey(V[reg]) == false)
     {
-        ++PC;
+        skip();
     }
 }
 
@@ -565,67 +1575,204 @@ void CHIP8::LDST(uint8_t reg)
     STIME = V[reg];
 }
 
+template <QuirkProfile P>
 void CHIP8::ADDI(uint8_t reg)
 {
     IC += V[reg];
-    if (add_i_carry && IC > 0x0FFF)
+    if (QUIRKS[static_cast<int>(P)].add_i_carry && IC > 0x0FFF)
     {
         V[0xF] = 0x01;
     }
 }
 
+// parks the machine on this instruction, poll_input finishes it when a key
+// goes down. until then run() idles and the timers keep ticking
 void CHIP8::LDK(uint8_t reg)
 {
-    uint8_t key;
-    while (true)
-    {
-        key = keypad->handleEvents();
-        if(key == 0xFF) clean_up();
-        if(key != 0xEE) break;
-        update_timers();
-    }
-    std::cout << "break from loop\n";
-    V[reg] = key;
-
+    waiting = true;
+    wait_reg = reg;
+    PC -= 2;
 }
 
 void CHIP8::LDF(uint8_t reg)
 {
-    IC = RAM[FONTSET_START + 5 * V[reg]];
+    IC = FONTSET_START + 5 * (V[reg] & 0xF);
 }
 
 void CHIP8::LDB(uint8_t reg)
 {
     uint8_t num = V[reg];
-    RAM[IC + 2] = static_cast<uint8_t>(num % 10);
+    mem[(IC + 2) & ram_mask] = static_cast<uint8_t>(num % 10);
     num /= 10;
-    RAM[IC + 1] = static_cast<uint8_t>(num % 10);
+    mem[(IC + 1) & ram_mask] = static_cast<uint8_t>(num % 10);
     num /= 10;
-    RAM[IC] = num % 10;
+    mem[IC & ram_mask] = num % 10;
+    invalidate(IC);
+    invalidate(IC + 1);
+    invalidate(IC + 2);
+    if (debugger != nullptr)
+    {
+        stored(IC, 3);
+    }
 }
 
+// the registers go to I, I + 1, ... and I only moves once they're all done
+template <QuirkProfile P>
 void CHIP8::RTM(uint8_t reg)
 {
     for (int i = 0x0; i <= reg; ++i)
     {
-        uint16_t start = IC;
-        RAM[start + i] = V[i];
-        if (change_i_on_copy)
-        {
-            ++IC;
-        }
+        mem[(IC + i) & ram_mask] = V[i];
+        invalidate(IC + i);
+    }
+    if (debugger != nullptr)
+    {
+        stored(IC, reg + 1);
+    }
+    if (QUIRKS[static_cast<int>(P)].load_store_i != I_UNCHANGED)
+    {
+        IC += reg + (QUIRKS[static_cast<int>(P)].load_store_i == I_PLUS_X_1);
     }
 }
 
+template <QuirkProfile P>
 void CHIP8::MTR(uint8_t reg)
 {
     for (int i = 0x0; i <= reg; ++i)
     {
-        uint16_t start = IC;
-        V[i] = RAM[start + i];
-        if (change_i_on_copy)
+        V[i] = mem[(IC + i) & ram_mask];
+    }
+    if (QUIRKS[static_cast<int>(P)].load_store_i != I_UNCHANGED)
+    {
+        IC += reg + (QUIRKS[static_cast<int>(P)].load_store_i == I_PLUS_X_1);
+    }
+}
+
+template <QuirkProfile P>
+const QuirkOps *CHIP8::quirk_handlers()
+{
+    static const QuirkOps ops = {
+        [](CHIP8 &c, const Op &o) { c.SHR<P>(o.x, o.y); },
+        [](CHIP8 &c, const Op &o) { c.SHL<P>(o.x, o.y); },
+        [](CHIP8 &c, const Op &o) { c.JPP<P>(o.nnn); },
+        [](CHIP8 &c, const Op &o) { c.ADDI<P>(o.x); },
+        [](CHIP8 &c, const Op &o) { c.RTM<P>(o.x); },
+        [](CHIP8 &c, const Op &o) { c.MTR<P>(o.x); },
+        [](CHIP8 &c, const Op &o)
         {
-            ++IC;
-        }
+            c.ADDI<P>(o.x);
+            c.PC += 2;
+            c.DRW(o.next >> 8 & 0xF, o.next >> 4 & 0xF, o.next & 0xF);
+            c.retired = 2;
+        },
+        [](CHIP8 &c, const Op &o) { c.ADDI<P>(o.x); c.PC += 2; c.ADDI<P>(o.next >> 8 & 0xF); c.retired = 2; },
+        [](CHIP8 &c, const Op &o) { c.ADDI<P>(o.x); c.PC += 2; c.RTM<P>(o.next >> 8 & 0xF); c.retired = 2; },
+        [](CHIP8 &c, const Op &o) { c.ADDI<P>(o.x); c.PC += 2; c.MTR<P>(o.next >> 8 & 0xF); c.retired = 2; }};
+    return &ops;
+}
+
+// the threaded loop is built per profile in Threaded.cpp and calls these
+#define QUIRK_METHODS(P)                                 \
+    template void CHIP8::SHR<P>(uint8_t, uint8_t);       \
+    template void CHIP8::SHL<P>(uint8_t, uint8_t);       \
+    template void CHIP8::JPP<P>(uint16_t);               \
+    template void CHIP8::ADDI<P>(uint8_t);               \
+    template void CHIP8::RTM<P>(uint8_t);                \
+    template void CHIP8::MTR<P>(uint8_t);
+QUIRK_METHODS(QuirkProfile::MODERN)
+QUIRK_METHODS(QuirkProfile::VIP)
+QUIRK_METHODS(QuirkProfile::CHIP48)
+QUIRK_METHODS(QuirkProfile::SCHIP)
+
+void CHIP8::SCD(uint8_t n)
+{
+    fb.scrollDown(planes, n);
+}
+
+void CHIP8::SCU(uint8_t n)
+{
+    fb.scrollUp(planes, n);
+}
+
+void CHIP8::SCR()
+{
+    fb.scrollRight(planes);
+}
+
+void CHIP8::SCL()
+{
+    fb.scrollLeft(planes);
+}
+
+// parks the machine on this instruction for good
+void CHIP8::EXIT()
+{
+    PC -= 2;
+}
+
+void CHIP8::LOW()
+{
+    fb.setHires(false);
+}
+
+void CHIP8::HIGH()
+{
+    fb.setHires(true);
+}
+
+void CHIP8::LDHF(uint8_t reg)
+{
+    IC = BIGFONT_START + 10 * (V[reg] & 0xF);
+}
+
+void CHIP8::SRPL(uint8_t reg)
+{
+    for (int i = 0x0; i <= reg; ++i)
+    {
+        RPL[i] = V[i];
+    }
+}
+
+void CHIP8::LRPL(uint8_t reg)
+{
+    for (int i = 0x0; i <= reg; ++i)
+    {
+        V[i] = RPL[i];
+    }
+}
+
+// Vx first, counting down when x > y
+void CHIP8::SRG(uint8_t x_reg, uint8_t y_reg)
+{
+    int step = x_reg <= y_reg ? 1 : -1;
+    for (int i = 0; i <= std::abs(y_reg - x_reg); ++i)
+    {
+        mem[(IC + i) & ram_mask] = V[x_reg + i * step];
+        invalidate(IC + i);
+    }
+    if (debugger != nullptr)
+    {
+        stored(IC, std::abs(y_reg - x_reg) + 1);
+    }
+}
+
+void CHIP8::LRG(uint8_t x_reg, uint8_t y_reg)
+{
+    int step = x_reg <= y_reg ? 1 : -1;
+    for (int i = 0; i <= std::abs(y_reg - x_reg); ++i)
+    {
+        V[x_reg + i * step] = mem[(IC + i) & ram_mask];
     }
 }
+
+// the address is the word after the instruction, which is stepped over
+void CHIP8::LDIL()
+{
+    IC = mem[PC & ram_mask] << 8 | mem[(PC + 1) & ram_mask];
+    PC += 2;
+}
+
+void CHIP8::PLANE(uint8_t mask)
+{
+    planes = mask & 0x3;
+}
@@ -3,77 +3,184 @@
 #include <memory>
 #include <fstream>
 #include <random>
-#include <time.h>
-#include <SDL2/SDL.h>
 #include "Display.h"
 #include "Keypad.h"
+#include "Audio.h"
+#include "MachineState.h"
+#include "Font.h"
+#include "Sha1.h"
+#include "Quirks.h"
+#include "Debugger.h"
 
 #ifndef CHIP8_H
 #define CHIP8_H
 
 #define NNN 0x0FFF
-#define ROM_START 0x200
-#define RAM_SIZE 0x1000
-#define REGISTER_COUNT 16
-#define STACK_HEIGHT 16
-#define FONTSET_SIZE 0x50
-#define FONTSET_START 0x50
-#define TPH 16.666667
+#define FRAME_RATE 60
 
-class CHIP8
+// per-instruction logging, build with -DCHIP8_LOG to get it back
+#ifdef CHIP8_LOG
+#define LOG(msg)              \
+    if (debug)                \
+    {                         \
+        std::cout << msg;     \
+    }
+#else
+#define LOG(msg)
+#endif
+
+// execution counters, build with -DCHIP8_PROFILE to get them
+#ifdef CHIP8_PROFILE
+#define PROFILE(call) profile->call
+#else
+#define PROFILE(call)
+#endif
+
+// computed goto dispatch, build with -DNO_THREADED_DISPATCH to leave it out
+#if defined(__GNUC__) && !defined(NO_THREADED_DISPATCH)
+#define THREADED_DISPATCH
+#endif
+
+class CHIP8;
+class JIT;
+class Trace;
+struct Profile;
+struct Op;
+typedef void (*OpHandler)(CHIP8 &, const Op &);
+
+// an instruction decoded once, with its operands already pulled out
+struct Op
 {
+    OpHandler handler = nullptr;
+    uint16_t instruction;
+    uint16_t nnn;
+    uint8_t x;
+    uint8_t y;
+    uint8_t n;
+    uint8_t kk;
+    // a superinstruction also runs the word after it, kept raw in next
+    uint16_t next = 0;
+    uint8_t count = 1;
+    // where the threaded engine jumps for it
+    uint8_t label = 0;
+};
+
+// handlers for the instructions that follow the quirk profile, one set per
+// profile, so the decoded cache runs them without testing any quirk
+struct QuirkOps
+{
+    OpHandler shr;
+    OpHandler shl;
+    OpHandler jpp;
+    OpHandler addi;
+    OpHandler rtm;
+    OpHandler mtr;
+    // superinstructions that start with Fx1E
+    OpHandler addi_drw;
+    OpHandler addi_addi;
+    OpHandler addi_rtm;
+    OpHandler addi_mtr;
+};
+
+enum class Engine
+{
+    INTERPRETER,
+    THREADED,
+    JIT
+};
+
+// instruction set, the extended ones always run on the interpreter
+enum class Variant
+{
+    CHIP8,
+    SCHIP,
+    XOCHIP
+};
+#define VARIANTS 3
+
+class CHIP8 : private MachineState
+{
+    friend class JIT;
+
 private:
-    uint8_t FONTSET[FONTSET_SIZE] = {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-    };
-    // memory
-    uint8_t RAM[RAM_SIZE];
-    // program counter
-    uint16_t PC;
-    // index counter
-    uint16_t IC;
-    // registers
-    uint8_t V[REGISTER_COUNT];
-    // stack
-    uint16_t STACK[STACK_HEIGHT];
-    // stack pointer
-    int SP;
+    // machine registers, memory and screen live in MachineState
+    // decoded instruction for each address, handler is null until first run.
+    // XO-CHIP's 64K addresses get theirs only while it's selected
+    Op OPS[RAM_SIZE];
+    std::unique_ptr<Op[]> XO_OPS;
+    // the variant's memory and decoded cache
+    uint8_t *mem = RAM;
+    Op *ops = OPS;
+    // execution engine, the jit falls back to the interpreter per instruction
+    Engine engine = Engine::INTERPRETER;
+    Variant variant = Variant::CHIP8;
+    // addresses wrap at the end of the variant's memory
+    uint16_t ram_mask = RAM_SIZE - 1;
+    // instructions the last superinstruction retired, and the running total
+    uint8_t retired = 0;
+    uint64_t fused = 0;
+    // instructions skipped in idle loops and Fx0A waits
+    uint64_t idle = 0;
+    // of the last ROM loaded
+    uint8_t rom_sha1[SHA1_SIZE] = {0};
+    std::unique_ptr<JIT> jit;
+    // binary execution trace, null unless tracing
+    std::unique_ptr<Trace> trace;
+    // null unless built with -DCHIP8_PROFILE, reported by clean_up
+    std::unique_ptr<Profile> profile;
+    // null unless a debugger is attached
+    std::unique_ptr<Debugger> debugger;
+    // run one instruction at a time: for tracing, and for what the engines
+    // can't check by themselves, register watchpoints and anything set on
+    // the threaded engine
+    bool stepping = false;
     // attachments
     std::unique_ptr<Display> display;
     std::unique_ptr<Keypad> keypad;
-    // timers
-    uint64_t dtStart;
-    uint8_t DTIME = 0;
-    uint64_t stStart;
-    uint8_t STIME = 0;
-    // quirk flags
-    bool copy_on_shift = false;
-    bool jump_offset_quirk = false;
-    bool add_i_carry = true;
-    bool change_i_on_copy = false;
+    // beeper, null for a silent machine
+    std::unique_ptr<Audio> audio;
+    // quirks, from the ROM database unless set_quirks chose them
+    QuirkProfile quirk = QuirkProfile::MODERN;
+    Quirks quirks = QUIRKS[0];
+    const QuirkOps *quirk_ops = nullptr;
+    bool quirks_chosen = false;
     //debug
     bool debug = true;
-    // random stuff
-    std::random_device rd;
-    std::mt19937 gen;
-    std::uniform_int_distribution<int> rnd;
+    // timers tick every ipf instructions
+    uint64_t ipf = 10;
     // display
-    void update_timers();
+    void tick_timers();
+    uint8_t random_byte();
+    uint64_t run_engine(uint64_t instructions);
+    uint64_t run_traced(uint64_t instructions);
+    uint64_t run_debugged(uint64_t instructions);
+    void update_stepping();
+    void breakpoint(const Op &op);
+    void stop(StopReason reason, uint16_t address);
+    void stored(uint16_t addr, uint16_t length);
+    uint64_t skip_idle(uint64_t budget);
+    Op decode(uint16_t instruction);
+    bool decode_extended(Op &op);
+    void fuse(Op &op, uint16_t next);
+    void skip();
+    void draw_planes(uint8_t x_reg, uint8_t y_reg, uint8_t n);
+    void load_fonts();
+    const Op &fetch_op();
+    void decode_at(Op &op, uint16_t addr);
+#ifdef THREADED_DISPATCH
+    uint8_t thread_label(const Op &op);
+    uint64_t run_threaded(uint64_t instructions);
+    template <QuirkProfile P>
+    uint64_t run_threaded_as(uint64_t instructions);
+#endif
+    template <QuirkProfile P>
+    static const QuirkOps *quirk_handlers();
+    void use_quirks(QuirkProfile profile);
+    void execute(const Op &op);
+    void invalidate(uint16_t addr);
+    void map_memory();
+    void drop_decoded();
+    void poll_input(uint8_t key);
     void CLS();                                        // 00E0 clear the display
     void RET();                                        // 00EE return
     void JP(uint16_t addr);                            // 1NNN jump to NNN
@@ -89,12 +196,15 @@ private:
     void XOR(uint8_t x_reg, uint8_t y_reg);            // 8xy3 XOR vx and vy - store in vx
     void ADDC(uint8_t x_reg, uint8_t y_reg);           // 8xy4 add vx and vy - store in vx, > 255, VF = 1
     void SUB(uint8_t x_reg, uint8_t y_reg);            // 8xy5 sub vx and vy - store in vx !!!
+    template <QuirkProfile P>
     void SHR(uint8_t x_reg, uint8_t y_reg);            // 8xy6 shift right
     void SUBN(uint8_t x_reg, uint8_t y_reg);           // 8xy7 sub vx from vy
+    template <QuirkProfile P>
     void SHL(uint8_t x_reg, uint8_t y_reg);            // 8xyE shift left
     void SNER(uint8_t x_reg, uint8_t y_reg);            // 9xy0 if vx != vy incr pc by 2
     void LDI(uint16_t addr);                           // Annn set IC to nnn
-    void JPP(uint16_t addr);                           // Bnnn jump to nnn + v0
+    template <QuirkProfile P>
+    void JPP(uint16_t addr);                           // Bnnn jump to nnn + v0 (vx with jump_vx)
     void RND(uint8_t reg, uint8_t byte);               // Cxkk gen rand 0-255 and with kk - store vx
     void DRW(uint8_t x_reg, uint8_t y_reg, uint8_t n); // DXYN draw
     void SKP(uint8_t reg);                             // Ex9E if vx is pressed, incr pc by 2
@@ -103,18 +213,91 @@ private:
     void LDK(uint8_t reg);                             // Fx0A wait for key, store in Vx
     void LDDT(uint8_t reg);                            // Fx15 set delay timer from vx
     void LDST(uint8_t reg);                            // Fx18 set sound timer from vx
+    template <QuirkProfile P>
     void ADDI(uint8_t reg);                            // Fx1E I += Vx
     void LDF(uint8_t reg);                             // Fx29 set I to hex font in Vx
     void LDB(uint8_t reg);                             // Fx33
+    template <QuirkProfile P>
     void RTM(uint8_t reg);                             // Fx55 store registers in memory from IC
+    template <QuirkProfile P>
     void MTR(uint8_t reg);                             // Fx65 store memory to registers from I
+    // SUPER-CHIP
+    void SCD(uint8_t n);                               // 00Cn scroll down n rows
+    void SCR();                                        // 00FB scroll right 4 pixels
+    void SCL();                                        // 00FC scroll left 4 pixels
+    void EXIT();                                       // 00FD stop the machine
+    void LOW();                                        // 00FE low-res
+    void HIGH();                                       // 00FF hi-res
+    void LDHF(uint8_t reg);                            // Fx30 set I to big hex font in Vx
+    void SRPL(uint8_t reg);                            // Fx75 store V0..Vx in the flag registers
+    void LRPL(uint8_t reg);                            // Fx85 load V0..Vx from the flag registers
+    // XO-CHIP
+    void SCU(uint8_t n);                               // 00Dn scroll up n rows
+    void SRG(uint8_t x_reg, uint8_t y_reg);            // 5xy2 store Vx..Vy from I, I unchanged
+    void LRG(uint8_t x_reg, uint8_t y_reg);            // 5xy3 load Vx..Vy from I, I unchanged
+    void LDIL();                                       // F000 NNNN set I to the next word
+    void PLANE(uint8_t mask);                          // Fn01 select bitplanes
 public:
     uint16_t fetch();
     void decode_and_execute(uint16_t instruction);
     void load_ROM(char const *filename);
+    void load_ROM(const uint8_t *data, size_t length);
+    const uint8_t *rom_digest();
     void print_RAM();
-    CHIP8(bool dbg);
+    const Framebuffer &framebuffer();
+    CHIP8(bool dbg, std::unique_ptr<Display> dsp, std::unique_ptr<Keypad> kpd);
+    ~CHIP8();
+    void set_engine(Engine e);
+    // before load_ROM, the memory size and fonts follow the variant
+    void set_variant(Variant v);
+    // overrides the ROM database for this and later ROMs
+    void set_quirks(QuirkProfile profile);
+    QuirkProfile quirk_profile();
+    uint64_t run(uint64_t instructions);
     void step();
+    // one 60 Hz frame: input, instructions up to the timer tick, one present
+    // unless a fast-forward is skipping it
+    void run_frame(bool present = true);
+    // Fx0A is waiting, the host can block on input instead of sleeping
+    bool waiting_for_key();
+    void wait_input(uint32_t timeout);
+    void set_speed(uint64_t instructions_per_frame);
+    // same seed, ROM and input give the same run, bit for bit
+    void seed(uint64_t value);
+    uint64_t cycle_count();
+    // instructions that ran as part of a superinstruction
+    uint64_t fused_count();
+    // instructions skipped rather than run while the machine was idle
+    uint64_t idle_count();
+    // save states, restore keeps decoded code that the state didn't change
+    MachineState snapshot();
+    void restore(const MachineState &state);
+    void save_state(char const *filename);
+    void load_state(char const *filename);
+    void set_audio(std::unique_ptr<Audio> a);
+    void start_trace(const char *filename);
+    void stop_trace();
+    // debugging, nothing is checked until a debugger is attached. a stopped
+    // machine runs nothing until resume()
+    void attach_debugger();
+    void detach_debugger();
+    void set_breakpoint(uint16_t addr, bool on);
+    void set_watchpoint(uint16_t addr, uint16_t length, bool on);
+    // a mask, bit n is Vn and WATCH_I is I
+    void watch_registers(uint32_t mask);
+    uint32_t watched_registers();
+    StopReason stop_reason();
+    // the watched byte or register the machine stopped on
+    uint16_t stop_address();
+    // a breakpoint the machine stopped on runs once
+    void resume();
+    // registers and memory in place, SP is trusted to be in [-1, 15].
+    // a memory write drops any decoded code it changes, and nothing else
+    DebugRegisters registers();
+    void set_registers(const DebugRegisters &regs);
+    const uint8_t *memory();
+    size_t memory_size();
+    void write_memory(uint16_t addr, const uint8_t *data, size_t length);
     void clean_up();
 };
 #endif // CHIP8_H
\ No newline at end of file
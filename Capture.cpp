@@ -0,0 +1,293 @@
+#include "Capture.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static const uint32_t PALETTE[4] = {PIXEL_OFF, PIXEL_ON, PIXEL_PLANE2, PIXEL_BOTH};
+static const uint32_t INDICES[4] = {0, 1, 2, 3};
+static const uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+// the most a stored deflate block holds
+#define STORED_BLOCK 65535
+
+static uint8_t channel(uint32_t argb, int shift)
+{
+    return (argb >> shift) & 0xFF;
+}
+
+static void put32(std::vector<uint8_t> &out, uint32_t value)
+{
+    uint8_t bytes[4] = {static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16),
+                        static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)};
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+struct CrcTable
+{
+    uint32_t entries[256];
+    CrcTable()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+static uint32_t crc32(const uint8_t *data, size_t length, uint32_t crc = 0)
+{
+    // built once, safely, by whichever writer thread gets here first
+    static const CrcTable crc_table;
+    const uint32_t *table = crc_table.entries;
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t adler32(const uint8_t *data, size_t length)
+{
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return b << 16 | a;
+}
+
+static void png_chunk(std::vector<uint8_t> &png, const char *type, const uint8_t *data, size_t length)
+{
+    put32(png, length);
+    size_t start = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data, data + length);
+    put32(png, crc32(png.data() + start, png.size() - start));
+}
+
+CaptureDisplay::CaptureDisplay(const char *filename, int cols, int rows, int pixel_scale)
+    : pattern(filename), width(cols * pixel_scale), height(rows * pixel_scale)
+{
+    auto ends_with = [this](const char *suffix)
+    { return pattern.size() >= strlen(suffix) && pattern.compare(pattern.size() - strlen(suffix), std::string::npos, suffix) == 0; };
+    format = ends_with(".y4m") ? CaptureFormat::Y4M : ends_with(".png") ? CaptureFormat::PNG : CaptureFormat::RGB;
+    if (format == CaptureFormat::PNG)
+    {
+        // the first run of # is where the frame number goes, padded to its length
+        number_at = pattern.find('#');
+        if (number_at == std::string::npos)
+        {
+            number_at = pattern.size() - 4;
+            pattern.insert(number_at, "-######");
+            ++number_at;
+        }
+        number_digits = pattern.find_first_not_of('#', number_at) - number_at;
+    }
+    else
+    {
+        out = fopen(filename, "wb");
+        if (out == nullptr)
+        {
+            std::cout << "cannot open video file\n";
+            exit(1);
+        }
+    }
+    if (format == CaptureFormat::Y4M)
+    {
+        fprintf(out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, CAPTURE_FPS);
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        int r = channel(PALETTE[i], 16), g = channel(PALETTE[i], 8), b = channel(PALETTE[i], 0);
+        rgb[i][0] = r;
+        rgb[i][1] = g;
+        rgb[i][2] = b;
+        // BT.601 studio range
+        yuv[0][i] = 16 + (66 * r + 129 * g + 25 * b + 128) / 256;
+        yuv[1][i] = 128 + (-38 * r - 74 * g + 112 * b + 128) / 256;
+        yuv[2][i] = 128 + (112 * r - 94 * g - 18 * b + 128) / 256;
+    }
+    indices.resize(HIRES_COLS * HIRES_ROWS);
+    scaled.reserve(1 + width * 3);
+    batch.reserve(CAPTURE_BATCH + width * height * 3);
+    writer = std::thread(&CaptureDisplay::write_loop, this);
+}
+
+CaptureDisplay::~CaptureDisplay()
+{
+    close();
+}
+
+void CaptureDisplay::close()
+{
+    if (!writer.joinable())
+    {
+        return;
+    }
+    running = false;
+    writer.join();
+    drain();
+    flush();
+    if (out != nullptr)
+    {
+        fclose(out);
+        out = nullptr;
+    }
+}
+
+uint64_t CaptureDisplay::frame_count()
+{
+    return frames;
+}
+
+int CaptureDisplay::frame_width()
+{
+    return width;
+}
+
+int CaptureDisplay::frame_height()
+{
+    return height;
+}
+
+void CaptureDisplay::write_loop()
+{
+    while (running)
+    {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void CaptureDisplay::drain()
+{
+    size_t count;
+    while ((count = ring.pop_bulk(pending, CAPTURE_FRAMES)) > 0)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            encode(pending[i]);
+        }
+    }
+}
+
+void CaptureDisplay::flush()
+{
+    if (out != nullptr && !batch.empty())
+    {
+        fwrite(batch.data(), 1, batch.size(), out);
+    }
+    batch.clear();
+}
+
+void CaptureDisplay::append_rows(int cols, int rows, const uint8_t *colour, int bytes_per_pixel, int lead)
+{
+    int across = width / cols;
+    int down = height / rows;
+    for (int r = 0; r < rows; ++r)
+    {
+        scaled.clear();
+        if (lead >= 0)
+        {
+            scaled.push_back(lead);
+        }
+        const uint32_t *line = indices.data() + r * cols;
+        for (int col = 0; col < cols; ++col)
+        {
+            const uint8_t *pixel = colour + line[col] * bytes_per_pixel;
+            for (int k = 0; k < across; ++k)
+            {
+                scaled.insert(scaled.end(), pixel, pixel + bytes_per_pixel);
+            }
+        }
+        for (int k = 0; k < down; ++k)
+        {
+            batch.insert(batch.end(), scaled.begin(), scaled.end());
+        }
+    }
+}
+
+void CaptureDisplay::encode(const Framebuffer &fb)
+{
+    int cols = fb.width(), rows = fb.height();
+    fb.expand(indices.data(), cols * sizeof(uint32_t), INDICES);
+    if (format == CaptureFormat::Y4M)
+    {
+        static const char header[] = "FRAME\n";
+        batch.insert(batch.end(), header, header + 6);
+        for (const uint8_t *plane : yuv)
+        {
+            append_rows(cols, rows, plane, 1, -1);
+        }
+    }
+    else if (format == CaptureFormat::RGB)
+    {
+        append_rows(cols, rows, rgb[0], 3, -1);
+    }
+    else
+    {
+        // scanlines with filter type 0 in front, palette indices as they are
+        static const uint8_t bytes[4] = {0, 1, 2, 3};
+        append_rows(cols, rows, bytes, 1, 0);
+        write_png();
+    }
+    ++frames;
+    if (batch.size() >= CAPTURE_BATCH)
+    {
+        flush();
+    }
+}
+
+// the scanlines in batch become one PNG file
+void CaptureDisplay::write_png()
+{
+    std::vector<uint8_t> png(PNG_SIGNATURE, PNG_SIGNATURE + 8);
+    std::vector<uint8_t> data;
+    put32(data, width);
+    put32(data, height);
+    const uint8_t header[5] = {8, 3, 0, 0, 0}; // 8-bit palette, no interlace
+    data.insert(data.end(), header, header + 5);
+    png_chunk(png, "IHDR", data.data(), data.size());
+
+    data.clear();
+    data.insert(data.end(), rgb[0], rgb[0] + 12);
+    png_chunk(png, "PLTE", data.data(), data.size());
+
+    // zlib stream of stored deflate blocks
+    data.assign({0x78, 0x01});
+    for (size_t at = 0; at < batch.size() || at == 0; at += STORED_BLOCK)
+    {
+        size_t length = std::min<size_t>(batch.size() - at, STORED_BLOCK);
+        const uint8_t block[5] = {static_cast<uint8_t>(at + length == batch.size()),
+                                  static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+                                  static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8)};
+        data.insert(data.end(), block, block + 5);
+        data.insert(data.end(), batch.begin() + at, batch.begin() + at + length);
+    }
+    put32(data, adler32(batch.data(), batch.size()));
+    png_chunk(png, "IDAT", data.data(), data.size());
+    png_chunk(png, "IEND", nullptr, 0);
+    batch.clear();
+
+    // the name is never a format string, only the number goes through printf
+    char number[24];
+    snprintf(number, sizeof(number), "%0*llu", number_digits, static_cast<unsigned long long>(frames));
+    std::string name = pattern;
+    name.replace(number_at, number_digits, number);
+    FILE *file = fopen(name.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::cout << "cannot open video file\n";
+        exit(1);
+    }
+    fwrite(png.data(), 1, png.size(), file);
+    fclose(file);
+}
@@ -0,0 +1,90 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Display.h"
+#include "SPSCRing.h"
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+// frames waiting for the writer, about 2 KB each
+#define CAPTURE_RING_SIZE 256
+#define CAPTURE_FRAMES 16
+// encoded bytes gathered before each write
+#define CAPTURE_BATCH (1 << 20)
+#define CAPTURE_FPS 60
+
+enum class CaptureFormat
+{
+    Y4M,
+    RGB,
+    PNG
+};
+
+// records every frame drawn. the emulation thread only copies the packed
+// framebuffer into a ring, and a writer thread turns frames into pixels
+// and writes them out in batches, so capture runs as fast as the core does.
+// the picture is cols x rows machine pixels times scale, and a low-res frame
+// on a hi-res sized capture is doubled up to fill it.
+//   .y4m  YUV4MPEG2, 4:4:4, 60 fps
+//   .png  one image per frame, the frame number replaces the first run of #
+//         in the name (or is added as -######), palette colour with stored
+//         deflate blocks
+//   else  raw rgb24 frames back to back
+class CaptureDisplay : public Display
+{
+private:
+    SPSCRing<Framebuffer, CAPTURE_RING_SIZE> ring;
+    CaptureFormat format;
+    std::string pattern;
+    // where the frame number goes in a png name, and how many digits it gets
+    size_t number_at = 0;
+    int number_digits = 0;
+    FILE *out = nullptr;
+    int width;
+    int height;
+    uint64_t frames = 0;
+    // the palette as rgb24 and as Y, Cb and Cr planes
+    uint8_t rgb[4][3];
+    uint8_t yuv[3][4];
+    // palette index per machine pixel, and one output row
+    std::vector<uint32_t> indices;
+    std::vector<uint8_t> scaled;
+    std::vector<uint8_t> batch;
+    // frames taken off the ring in one go
+    Framebuffer pending[CAPTURE_FRAMES];
+    std::atomic<bool> running{true};
+    std::thread writer;
+
+    void write_loop();
+    void drain();
+    void flush();
+    void encode(const Framebuffer &fb);
+    // appends the expanded frame as rows of bytes, colour maps each palette
+    // index to bytes_per_pixel bytes, and every row starts with lead if it's
+    // not negative
+    void append_rows(int cols, int rows, const uint8_t *colour, int bytes_per_pixel, int lead);
+    void write_png();
+
+public:
+    CaptureDisplay(const char *filename, int cols, int rows, int pixel_scale);
+    ~CaptureDisplay();
+    void draw(const Framebuffer &fb) override
+    {
+        while (!ring.push(fb))
+        {
+            std::this_thread::yield();
+        }
+    }
+    // finishes writing everything drawn so far
+    void destroy_window() override { close(); }
+    void close();
+    uint64_t frame_count();
+    int frame_width();
+    int frame_height();
+};
+
+#endif // CAPTURE_H
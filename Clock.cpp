@@ -0,0 +1,17 @@
+#include "Clock.h"
+#include <thread>
+
+SteadyClock::SteadyClock() : start(std::chrono::steady_clock::now())
+{
+}
+
+uint64_t SteadyClock::now()
+{
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void SteadyClock::sleep_until(uint64_t time)
+{
+    std::this_thread::sleep_until(start + std::chrono::microseconds(time));
+}
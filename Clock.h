@@ -0,0 +1,40 @@
+#include <stdint.h>
+#include <chrono>
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+// host time source used to pace frames, in microseconds
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+    virtual uint64_t now() = 0;
+    virtual void sleep_until(uint64_t time) = 0;
+};
+
+// host clock that does not depend on SDL
+class SteadyClock : public Clock
+{
+private:
+    std::chrono::steady_clock::time_point start;
+
+public:
+    SteadyClock();
+    uint64_t now() override;
+    void sleep_until(uint64_t time) override;
+};
+
+// never sleeps, time jumps straight to whatever was waited for, so a paced
+// loop runs as fast as the host allows
+class VirtualClock : public Clock
+{
+private:
+    uint64_t time = 0;
+
+public:
+    uint64_t now() override { return time; }
+    void sleep_until(uint64_t t) override { time = t > time ? t : time; }
+};
+
+#endif // CLOCK_H
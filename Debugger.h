@@ -0,0 +1,97 @@
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "MachineState.h"
+
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+// bit n of a register watch mask is Vn, I is bit WATCH_I
+#define WATCH_I 16
+
+// what a debugger reads and writes, without copying the whole machine
+struct DebugRegisters
+{
+    uint8_t V[REGISTER_COUNT];
+    uint16_t I;
+    uint16_t PC;
+    int32_t SP;
+    uint8_t DT;
+    uint8_t ST;
+};
+
+enum class StopReason
+{
+    NONE,
+    BREAKPOINT,
+    WATCHPOINT,
+    REGISTER
+};
+
+// breakpoints and watchpoints for one machine. CHIP8 only keeps one while a
+// debugger is attached, and only looks at it when it decodes an instruction,
+// translates a block or stores to memory, so an attached debugger with
+// nothing set costs nothing.
+struct Debugger
+{
+    // a bit per address
+    uint64_t breakpoints[XO_RAM_SIZE / 64] = {0};
+    int breakpoint_count = 0;
+    // write watchpoints, first address and length
+    std::vector<std::pair<uint16_t, uint16_t>> watches;
+    // registers that stop the machine when they change
+    uint32_t registers = 0;
+    // why the machine stopped, and the watched byte or register it was
+    StopReason reason = StopReason::NONE;
+    uint16_t address = 0;
+    // the breakpoint here runs its instruction once, to step off it
+    int32_t resume_at = -1;
+    // a watched store stops the machine in front of the next instruction
+    int32_t stop_at = -1;
+
+    bool breaks(uint16_t addr) const
+    {
+        return (breakpoints[addr >> 6] >> (addr & 63) & 1) || addr == stop_at;
+    }
+    void set(uint16_t addr, bool on)
+    {
+        if (on == static_cast<bool>(breakpoints[addr >> 6] >> (addr & 63) & 1))
+        {
+            return;
+        }
+        breakpoints[addr >> 6] ^= 1ULL << (addr & 63);
+        breakpoint_count += on ? 1 : -1;
+    }
+    // the first watched byte in [addr, addr + length), or -1
+    int32_t watched(uint16_t addr, uint16_t length) const
+    {
+        for (const auto &w : watches)
+        {
+            uint16_t first = std::max(addr, w.first);
+            if (first < addr + length && first < w.first + w.second)
+            {
+                return first;
+            }
+        }
+        return -1;
+    }
+    // any instruction from head to tail
+    bool breaks(uint16_t head, uint16_t tail) const
+    {
+        for (uint32_t addr = head; addr <= tail; addr += 2)
+        {
+            if (breaks(addr))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    bool armed() const
+    {
+        return breakpoint_count > 0 || !watches.empty() || registers != 0;
+    }
+};
+
+#endif // DEBUGGER_H
@@ -0,0 +1,100 @@
+#include "Disasm.h"
+#include <cstdio>
+
+std::string disassemble(uint16_t instruction)
+{
+    char buf[32];
+    unsigned x = (instruction >> 8) & 0xF;
+    unsigned y = (instruction >> 4) & 0xF;
+    unsigned n = instruction & 0xF;
+    unsigned kk = instruction & 0xFF;
+    unsigned nnn = instruction & 0x0FFF;
+    static const char *const alu[16] = {"LDR", "OR", "AND", "XOR", "ADDC", "SUB", "SHR", "SUBN",
+                                        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL", nullptr};
+    switch (instruction >> 12)
+    {
+    case 0x0:
+        if (nnn == 0x0E0)
+            return "CLS";
+        if (nnn == 0x0EE)
+            return "RET";
+        if (nnn == 0x0FB)
+            return "SCR";
+        if (nnn == 0x0FC)
+            return "SCL";
+        if (nnn == 0x0FD)
+            return "EXIT";
+        if (nnn == 0x0FE)
+            return "LOW";
+        if (nnn == 0x0FF)
+            return "HIGH";
+        if ((nnn & 0xFF0) == 0x0C0 || (nnn & 0xFF0) == 0x0D0)
+        {
+            snprintf(buf, sizeof(buf), "%-4s %X", (nnn & 0xFF0) == 0x0C0 ? "SCD" : "SCU", n);
+            break;
+        }
+        snprintf(buf, sizeof(buf), "SYS  %03X", nnn);
+        break;
+    case 0x1: snprintf(buf, sizeof(buf), "JP   %03X", nnn); break;
+    case 0x2: snprintf(buf, sizeof(buf), "CALL %03X", nnn); break;
+    case 0x3: snprintf(buf, sizeof(buf), "SE   V%X, %02X", x, kk); break;
+    case 0x4: snprintf(buf, sizeof(buf), "SNE  V%X, %02X", x, kk); break;
+    case 0x5:
+        snprintf(buf, sizeof(buf), "%-4s V%X, V%X", n == 0x2 ? "SRG" : n == 0x3 ? "LRG" : "SER", x, y);
+        break;
+    case 0x6: snprintf(buf, sizeof(buf), "LD   V%X, %02X", x, kk); break;
+    case 0x7: snprintf(buf, sizeof(buf), "ADD  V%X, %02X", x, kk); break;
+    case 0x8:
+        if (alu[n] == nullptr)
+        {
+            snprintf(buf, sizeof(buf), "???  %04X", instruction);
+            break;
+        }
+        snprintf(buf, sizeof(buf), "%-4s V%X, V%X", alu[n], x, y);
+        break;
+    case 0x9: snprintf(buf, sizeof(buf), "SNER V%X, V%X", x, y); break;
+    case 0xA: snprintf(buf, sizeof(buf), "LDI  %03X", nnn); break;
+    case 0xB: snprintf(buf, sizeof(buf), "JPP  %03X", nnn); break;
+    case 0xC: snprintf(buf, sizeof(buf), "RND  V%X, %02X", x, kk); break;
+    case 0xD: snprintf(buf, sizeof(buf), "DRW  V%X, V%X, %X", x, y, n); break;
+    case 0xE:
+        if (kk == 0x9E)
+            snprintf(buf, sizeof(buf), "SKP  V%X", x);
+        else if (kk == 0xA1)
+            snprintf(buf, sizeof(buf), "SKNP V%X", x);
+        else
+            snprintf(buf, sizeof(buf), "???  %04X", instruction);
+        break;
+    default:
+    {
+        if (instruction == 0xF000)
+            return "LDIL";
+        if (kk == 0x01)
+        {
+            snprintf(buf, sizeof(buf), "PLANE %X", x);
+            break;
+        }
+        const char *name = nullptr;
+        switch (kk)
+        {
+        case 0x07: name = "LDT"; break;
+        case 0x0A: name = "LDK"; break;
+        case 0x15: name = "LDDT"; break;
+        case 0x18: name = "LDST"; break;
+        case 0x1E: name = "ADDI"; break;
+        case 0x29: name = "LDF"; break;
+        case 0x30: name = "LDHF"; break;
+        case 0x33: name = "LDB"; break;
+        case 0x55: name = "RTM"; break;
+        case 0x65: name = "MTR"; break;
+        case 0x75: name = "SRPL"; break;
+        case 0x85: name = "LRPL"; break;
+        }
+        if (name == nullptr)
+            snprintf(buf, sizeof(buf), "???  %04X", instruction);
+        else
+            snprintf(buf, sizeof(buf), "%-4s V%X", name, x);
+    }
+    }
+    return buf;
+}
@@ -0,0 +1,10 @@
+#include <stdint.h>
+#include <string>
+
+#ifndef DISASM_H
+#define DISASM_H
+
+// mnemonics follow the instruction names used in CHIP8.h
+std::string disassemble(uint16_t instruction);
+
+#endif // DISASM_H
@@ -1,31 +1,46 @@
 #include <stdint.h>
-#include <memory>
-#include <functional>
-#include <SDL2/SDL.h>
 #include <iostream>
+#include "Framebuffer.h"
+#include "TripleBuffer.h"
 
 #ifndef DISPLAY_H
 #define DISPLAY_H
 
-#define ROWS 32
-#define COLS 64
 #define PIXEL_SCALE 10
+// ARGB, shared by the window and video capture
+#define PIXEL_ON 0xFFFFFFFF
+#define PIXEL_OFF 0xFF000000
+// XO-CHIP colours for plane 1 alone and both planes lit
+#define PIXEL_PLANE2 0xFFFF8800
+#define PIXEL_BOTH 0xFF888888
 class Display
 {
+public:
+    virtual ~Display() = default;
+    virtual void draw(const Framebuffer &fb) = 0;
+    virtual void destroy_window() {}
+};
+
+// memory-only backend, the core keeps the pixels and nothing is rendered
+class NullDisplay : public Display
+{
+public:
+    void draw(const Framebuffer &fb) override {}
+};
+
+// hands each frame to a render thread, which shows the latest one it finds
+class FrameDisplay : public Display
+{
 private:
-    bool display[ROWS][COLS] = {{false}};
-    std::unique_ptr<SDL_Window, decltype(&SDL_DestroyWindow)> window;
-    std::unique_ptr<SDL_Renderer, decltype(&SDL_DestroyRenderer)> renderer;
+    TripleBuffer<Framebuffer> &frames;
 
 public:
-    Display();
-    void setPixel(uint8_t row, uint8_t col, bool on);
-    [[nodiscard]] bool getPixel(uint8_t row, uint8_t col);
-    void draw();
-    void clear();
-    void init_SDL();
-    void destroy_window();
-    std::unique_ptr<SDL_Rect> rect_from_pixel(int row, int col);
+    FrameDisplay(TripleBuffer<Framebuffer> &f) : frames(f) {}
+    void draw(const Framebuffer &fb) override
+    {
+        frames.write_slot() = fb;
+        frames.publish();
+    }
 };
 
-#endif // DISPLAY_H
\ No newline at end of file
+#endif // DISPLAY_H
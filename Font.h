@@ -0,0 +1,18 @@
+#include <stdint.h>
+
+#ifndef FONT_H
+#define FONT_H
+
+#define FONTSET_SIZE 0x50
+#define FONTSET_START 0x50
+
+// 4x5 hex digits, loaded at FONTSET_START
+extern const uint8_t FONTSET[FONTSET_SIZE];
+
+#define BIGFONT_SIZE 0xA0
+#define BIGFONT_START (FONTSET_START + FONTSET_SIZE)
+
+// SUPER-CHIP 8x10 hex digits, loaded at BIGFONT_START for Fx30
+extern const uint8_t BIGFONT[BIGFONT_SIZE];
+
+#endif // FONT_H
@@ -0,0 +1,215 @@
+#include "Framebuffer.h"
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+bool Framebuffer::getPixel(uint8_t r, uint8_t col) const
+{
+    return (row(0, r)[col >> 6] >> (63 - (col & 63))) & 0x1;
+}
+
+void Framebuffer::setPixel(uint8_t r, uint8_t col, bool on)
+{
+    uint64_t bit = 1ULL << (63 - (col & 63));
+    uint64_t &word = row(0, r)[col >> 6];
+    word = on ? (word | bit) : (word & ~bit);
+}
+
+uint8_t Framebuffer::getColor(uint8_t r, uint8_t col) const
+{
+    int shift = 63 - (col & 63);
+    return ((row(0, r)[col >> 6] >> shift) & 0x1) | ((row(1, r)[col >> 6] >> shift) & 0x1) << 1;
+}
+
+void Framebuffer::clear(uint8_t planes)
+{
+    int visible = height() * words();
+    for (int plane = 0; plane < PLANES; ++plane)
+    {
+        if (!(planes & (1 << plane)))
+        {
+            continue;
+        }
+#ifdef __SSE2__
+        __m128i zero = _mm_setzero_si128();
+        for (int i = 0; i < visible; i += 2)
+        {
+            _mm_store_si128(reinterpret_cast<__m128i *>(bits[plane] + i), zero);
+        }
+#else
+        std::memset(bits[plane], 0, visible * sizeof(uint64_t));
+#endif
+    }
+}
+
+void Framebuffer::setHires(bool on)
+{
+    // clear the old mode's words before the layout changes
+    clear();
+    hires = on;
+}
+
+bool Framebuffer::equals(const Framebuffer &other) const
+{
+    if (hires != other.hires)
+    {
+        return false;
+    }
+    int visible = height() * words();
+#ifdef __SSE2__
+    __m128i diff = _mm_setzero_si128();
+    for (int plane = 0; plane < PLANES; ++plane)
+    {
+        for (int i = 0; i < visible; i += 2)
+        {
+            __m128i a = _mm_load_si128(reinterpret_cast<const __m128i *>(bits[plane] + i));
+            __m128i b = _mm_load_si128(reinterpret_cast<const __m128i *>(other.bits[plane] + i));
+            diff = _mm_or_si128(diff, _mm_xor_si128(a, b));
+        }
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) == 0xFFFF;
+#else
+    uint64_t diff = 0;
+    for (int plane = 0; plane < PLANES; ++plane)
+    {
+        for (int i = 0; i < visible; ++i)
+        {
+            diff |= bits[plane][i] ^ other.bits[plane][i];
+        }
+    }
+    return diff == 0;
+#endif
+}
+
+uint64_t Framebuffer::hash() const
+{
+    uint64_t h = 0xCBF29CE484222325ULL;
+    h ^= hires;
+    h *= 0x100000001B3ULL;
+    int visible = height() * words();
+    for (int plane = 0; plane < PLANES; ++plane)
+    {
+        for (int i = 0; i < visible; ++i)
+        {
+            for (int shift = 56; shift >= 0; shift -= 8)
+            {
+                h ^= (bits[plane][i] >> shift) & 0xFF;
+                h *= 0x100000001B3ULL;
+            }
+        }
+    }
+    return h;
+}
+
+// words with nothing on plane 1 take the plain two-colour path
+void Framebuffer::expand(uint32_t *pixels, int pitch, const uint32_t palette[4]) const
+{
+    for (int r = 0; r < height(); ++r)
+    {
+        uint32_t *line = reinterpret_cast<uint32_t *>(reinterpret_cast<uint8_t *>(pixels) + r * pitch);
+        for (int word = 0; word < words(); ++word, line += 64)
+        {
+            uint64_t low = row(0, r)[word];
+            uint64_t high = row(1, r)[word];
+            if (high == 0)
+            {
+                for (int col = 0; col < 64; ++col)
+                {
+                    line[col] = (low >> (63 - col)) & 0x1 ? palette[1] : palette[0];
+                }
+                continue;
+            }
+            for (int col = 0; col < 64; ++col)
+            {
+                line[col] = palette[((low >> (63 - col)) & 0x1) | ((high >> (63 - col)) & 0x1) << 1];
+            }
+        }
+    }
+}
+
+void Framebuffer::scrollDown(uint8_t planes, uint8_t n)
+{
+    int count = (n < height() ? n : height()) * words();
+    int visible = height() * words();
+    for (int plane = 0; plane < PLANES; ++plane)
+    {
+        if (planes & (1 << plane))
+        {
+            std::memmove(bits[plane] + count, bits[plane], (visible - count) * sizeof(uint64_t));
+            std::memset(bits[plane], 0, count * sizeof(uint64_t));
+        }
+    }
+}
+
+void Framebuffer::scrollUp(uint8_t planes, uint8_t n)
+{
+    int count = (n < height() ? n : height()) * words();
+    int visible = height() * words();
+    for (int plane = 0; plane < PLANES; ++plane)
+    {
+        if (planes & (1 << plane))
+        {
+            std::memmove(bits[plane], bits[plane] + count, (visible - count) * sizeof(uint64_t));
+            std::memset(bits[plane] + visible - count, 0, count * sizeof(uint64_t));
+        }
+    }
+}
+
+// two words at a time: two low-res rows, or one hi-res row whose words
+// shift together with the bits leaving one carried into the other
+void Framebuffer::scrollRight(uint8_t planes)
+{
+    int visible = height() * words();
+    for (int plane = 0; plane < PLANES; ++plane)
+    {
+        if (!(planes & (1 << plane)))
+        {
+            continue;
+        }
+#ifdef __SSE2__
+        __m128i carries = hires ? _mm_set1_epi32(-1) : _mm_setzero_si128();
+        for (int i = 0; i < visible; i += 2)
+        {
+            __m128i *p = reinterpret_cast<__m128i *>(bits[plane] + i);
+            __m128i v = _mm_load_si128(p);
+            __m128i carry = _mm_and_si128(_mm_slli_si128(_mm_slli_epi64(v, 64 - SCROLL_STEP), 8), carries);
+            _mm_store_si128(p, _mm_or_si128(_mm_srli_epi64(v, SCROLL_STEP), carry));
+        }
+#else
+        for (int i = visible - 1; i >= 0; --i)
+        {
+            uint64_t carry = hires && (i & 1) ? bits[plane][i - 1] << (64 - SCROLL_STEP) : 0;
+            bits[plane][i] = bits[plane][i] >> SCROLL_STEP | carry;
+        }
+#endif
+    }
+}
+
+void Framebuffer::scrollLeft(uint8_t planes)
+{
+    int visible = height() * words();
+    for (int plane = 0; plane < PLANES; ++plane)
+    {
+        if (!(planes & (1 << plane)))
+        {
+            continue;
+        }
+#ifdef __SSE2__
+        __m128i carries = hires ? _mm_set1_epi32(-1) : _mm_setzero_si128();
+        for (int i = 0; i < visible; i += 2)
+        {
+            __m128i *p = reinterpret_cast<__m128i *>(bits[plane] + i);
+            __m128i v = _mm_load_si128(p);
+            __m128i carry = _mm_and_si128(_mm_srli_si128(_mm_srli_epi64(v, 64 - SCROLL_STEP), 8), carries);
+            _mm_store_si128(p, _mm_or_si128(_mm_slli_epi64(v, SCROLL_STEP), carry));
+        }
+#else
+        for (int i = 0; i < visible; ++i)
+        {
+            uint64_t carry = hires && !(i & 1) ? bits[plane][i + 1] >> (64 - SCROLL_STEP) : 0;
+            bits[plane][i] = bits[plane][i] << SCROLL_STEP | carry;
+        }
+#endif
+    }
+}
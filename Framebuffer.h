@@ -0,0 +1,90 @@
+#include <stdint.h>
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+// low-res CHIP-8 screen
+#define ROWS 32
+#define COLS 64
+// SUPER-CHIP / XO-CHIP hi-res screen
+#define HIRES_ROWS 64
+#define HIRES_COLS 128
+// XO-CHIP bitplanes
+#define PLANES 2
+// pixels a SUPER-CHIP horizontal scroll moves
+#define SCROLL_STEP 4
+
+static_assert(HIRES_COLS == 128, "each row is packed into two uint64_t");
+
+// each plane is a run of packed rows, column 0 is the most significant bit.
+// a low-res row is one word and a hi-res row two, so the visible part of a
+// plane is always its first height() * words() words. everything past that
+// is kept clear.
+struct alignas(32) Framebuffer
+{
+    uint64_t bits[PLANES][HIRES_ROWS * 2] = {};
+    bool hires = false;
+
+    int width() const { return hires ? HIRES_COLS : COLS; }
+    int height() const { return hires ? HIRES_ROWS : ROWS; }
+    // words per row
+    int words() const { return hires ? 2 : 1; }
+    uint64_t *row(uint8_t plane, uint8_t r) { return bits[plane] + r * words(); }
+    const uint64_t *row(uint8_t plane, uint8_t r) const { return bits[plane] + r * words(); }
+    // plane 0
+    bool getPixel(uint8_t row, uint8_t col) const;
+    void setPixel(uint8_t row, uint8_t col, bool on);
+    // bit p is set when plane p is lit
+    uint8_t getColor(uint8_t row, uint8_t col) const;
+    // planes is a mask, bit p clears plane p
+    void clear(uint8_t planes = 0x3);
+    // switching modes clears every plane
+    void setHires(bool on);
+    bool equals(const Framebuffer &other) const;
+    // FNV-1a over the mode and the visible words of every plane, most
+    // significant byte first, same on any host
+    uint64_t hash() const;
+    // writes width() x height() 32-bit pixels, palette is indexed by
+    // getColor, pitch is in bytes
+    void expand(uint32_t *pixels, int pitch, const uint32_t palette[4]) const;
+    // xors an 8 pixel sprite row into low-res plane 0 at (row, col),
+    // clipping at the right edge. returns true if any lit pixel was turned off.
+    bool drawRow(uint8_t row, uint8_t col, uint8_t sprite);
+    // same for any plane and mode, sprite is left-aligned in 16 bits
+    bool drawRow16(uint8_t plane, uint8_t row, uint8_t col, uint16_t sprite);
+    // whole-row moves on the selected planes, new pixels come in clear
+    void scrollDown(uint8_t planes, uint8_t n);
+    void scrollUp(uint8_t planes, uint8_t n);
+    void scrollRight(uint8_t planes);
+    void scrollLeft(uint8_t planes);
+};
+
+inline bool Framebuffer::drawRow(uint8_t row, uint8_t col, uint8_t sprite)
+{
+    uint64_t pixels = static_cast<uint64_t>(sprite) << 56 >> col;
+    bool collision = (bits[0][row] & pixels) != 0;
+    bits[0][row] ^= pixels;
+    return collision;
+}
+
+// in hi-res the sprite straddles the two words when col is past 48
+inline bool Framebuffer::drawRow16(uint8_t plane, uint8_t r, uint8_t col, uint16_t sprite)
+{
+    uint64_t pixels = static_cast<uint64_t>(sprite) << 48;
+    uint64_t *line = row(plane, r);
+    if (!hires)
+    {
+        pixels >>= col;
+        bool collision = (line[0] & pixels) != 0;
+        line[0] ^= pixels;
+        return collision;
+    }
+    uint64_t left = col < 64 ? pixels >> col : 0;
+    uint64_t right = col < 64 ? (col > 48 ? pixels << (64 - col) : 0) : pixels >> (col - 64);
+    bool collision = ((line[0] & left) | (line[1] & right)) != 0;
+    line[0] ^= left;
+    line[1] ^= right;
+    return collision;
+}
+
+#endif // FRAMEBUFFER_H
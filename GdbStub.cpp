@@ -0,0 +1,525 @@
+#include "GdbStub.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Disasm.h"
+
+// register numbers in g/p packets and in the target description
+#define REG_I 16
+#define REG_PC 17
+#define REG_SP 18
+#define REG_DT 19
+#define REG_ST 20
+#define REG_COUNT 21
+
+static const char *const REG_NAMES[REG_COUNT] = {
+    "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "va", "vb", "vc", "vd", "ve", "vf",
+    "i", "pc", "sp", "dt", "st"};
+
+// where a register sits in the g packet
+static size_t reg_offset(unsigned reg)
+{
+    return reg <= REG_I ? reg : reg == REG_PC ? REG_I + 2 : reg + 2;
+}
+
+static size_t reg_size(unsigned reg)
+{
+    return reg == REG_I || reg == REG_PC ? 2 : 1;
+}
+
+static std::string hex(const uint8_t *bytes, size_t length)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < length; ++i)
+    {
+        out += digits[bytes[i] >> 4];
+        out += digits[bytes[i] & 0xF];
+    }
+    return out;
+}
+
+static std::string hex(const std::string &text)
+{
+    return hex(reinterpret_cast<const uint8_t *>(text.data()), text.size());
+}
+
+static std::string unhex(const std::string &digits)
+{
+    std::string out;
+    for (size_t i = 0; i + 1 < digits.size(); i += 2)
+    {
+        out += static_cast<char>(strtoul(digits.substr(i, 2).c_str(), nullptr, 16));
+    }
+    return out;
+}
+
+static std::string target_xml()
+{
+    std::string xml = "<?xml version=\"1.0\"?><!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+                      "<target version=\"1.0\"><feature name=\"org.chip8.core\">";
+    for (int r = 0; r < REG_COUNT; ++r)
+    {
+        int bits = r == REG_I || r == REG_PC ? 16 : 8;
+        const char *type = r == REG_PC ? "code_ptr" : r == REG_I ? "data_ptr" : "uint8";
+        xml += "<reg name=\"" + std::string(REG_NAMES[r]) + "\" bitsize=\"" + std::to_string(bits) +
+               "\" type=\"" + type + "\"/>";
+    }
+    return xml + "</feature></target>";
+}
+
+GdbStub::GdbStub(CHIP8 &c, const std::string &address)
+    : chip8(c)
+{
+    int listener;
+    if (address.find('/') != std::string::npos)
+    {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(addr.sun_path);
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            std::cout << "cannot listen on " << address << "\n";
+            exit(1);
+        }
+    }
+    else
+    {
+        // loopback only, the stub can read and write the whole machine
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(atoi(address.c_str()));
+        int on = 1;
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            std::cout << "cannot listen on " << address << "\n";
+            exit(1);
+        }
+    }
+    listen(listener, 1);
+    std::cout << "waiting for gdb on " << address << "\n";
+    client = accept(listener, nullptr, nullptr);
+    close(listener);
+    if (client < 0)
+    {
+        std::cout << "cannot accept on " << address << "\n";
+        exit(1);
+    }
+    int on = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    chip8.attach_debugger();
+}
+
+GdbStub::~GdbStub()
+{
+    // the run ended under the client, tell it the program exited
+    if (client >= 0)
+    {
+        send("W00");
+        disconnect();
+    }
+}
+
+// -1 when nothing is waiting, or the client went away
+int GdbStub::read_byte(bool block)
+{
+    if (input.empty())
+    {
+        char buffer[GDB_PACKET_SIZE];
+        ssize_t got = recv(client, buffer, sizeof(buffer), block ? 0 : MSG_DONTWAIT);
+        if (got == 0 || (got < 0 && block))
+        {
+            disconnect();
+            return -1;
+        }
+        if (got < 0)
+        {
+            return -1;
+        }
+        input.assign(buffer, got);
+    }
+    uint8_t b = input[0];
+    input.erase(0, 1);
+    return b;
+}
+
+// $data#checksum, acked without checking the sum since the link is local.
+// a ^C between packets comes back as a packet of its own
+bool GdbStub::read_packet(std::string &packet)
+{
+    int b;
+    do
+    {
+        b = read_byte(true);
+    } while (b >= 0 && b != '$' && b != 0x03);
+    if (b < 0)
+    {
+        return false;
+    }
+    packet.clear();
+    if (b == 0x03)
+    {
+        packet += static_cast<char>(b);
+        return true;
+    }
+    while ((b = read_byte(true)) >= 0 && b != '#')
+    {
+        packet += static_cast<char>(b);
+    }
+    if (b < 0 || read_byte(true) < 0 || read_byte(true) < 0)
+    {
+        return false;
+    }
+    ::send(client, "+", 1, MSG_NOSIGNAL);
+    return true;
+}
+
+void GdbStub::send(const std::string &data)
+{
+    uint8_t sum = 0;
+    for (char ch : data)
+    {
+        sum += static_cast<uint8_t>(ch);
+    }
+    std::string packet = "$" + data + "#" + hex(&sum, 1);
+    ::send(client, packet.data(), packet.size(), MSG_NOSIGNAL);
+}
+
+void GdbStub::disconnect()
+{
+    close(client);
+    client = -1;
+    running = true;
+    input.clear();
+    chip8.detach_debugger();
+}
+
+void GdbStub::hang_up()
+{
+    shutdown(client, SHUT_RDWR);
+}
+
+bool GdbStub::poll()
+{
+    if (client >= 0 && running)
+    {
+        if (chip8.stop_reason() != StopReason::NONE)
+        {
+            running = false;
+            send(stop_reply());
+        }
+        else if (read_byte(false) == 0x03)
+        {
+            running = false;
+            send("S02");
+        }
+    }
+    std::string packet;
+    while (client >= 0 && !running && read_packet(packet))
+    {
+        handle(packet);
+    }
+    return !killed;
+}
+
+std::string GdbStub::stop_reply()
+{
+    if (chip8.stop_reason() == StopReason::WATCHPOINT)
+    {
+        char reply[32];
+        snprintf(reply, sizeof(reply), "T05watch:%x;", chip8.stop_address());
+        return reply;
+    }
+    return "S05";
+}
+
+// little-endian, in REG_NAMES order
+std::string GdbStub::read_registers()
+{
+    DebugRegisters state = chip8.registers();
+    uint8_t regs[REGISTER_COUNT + 7];
+    std::memcpy(regs, state.V, REGISTER_COUNT);
+    regs[16] = state.I & 0xFF;
+    regs[17] = state.I >> 8;
+    regs[18] = state.PC & 0xFF;
+    regs[19] = state.PC >> 8;
+    regs[20] = static_cast<uint8_t>(state.SP);
+    regs[21] = state.DT;
+    regs[22] = state.ST;
+    return hex(regs, sizeof(regs));
+}
+
+void GdbStub::handle(const std::string &packet)
+{
+    unsigned addr = 0, length = 0, type = 0, reg = 0;
+    switch (packet[0])
+    {
+    case 0x03:
+        // already stopped
+        send("S02");
+        break;
+    case '?':
+        send(stop_reply());
+        break;
+    case 'g':
+        send(read_registers());
+        break;
+    case 'G':
+    case 'P':
+    {
+        std::string bytes = unhex(packet[0] == 'G' ? packet.substr(1) : read_registers());
+        if (packet[0] == 'P')
+        {
+            size_t eq = packet.find('=');
+            if (sscanf(packet.c_str() + 1, "%x", &reg) != 1 || eq == std::string::npos || reg >= REG_COUNT)
+            {
+                send("E01");
+                break;
+            }
+            std::string value = unhex(packet.substr(eq + 1));
+            bytes.replace(reg_offset(reg), reg_size(reg), value.substr(0, reg_size(reg)));
+        }
+        // an SP outside the stack would make RET and CALL index past it
+        if (bytes.size() < REGISTER_COUNT + 7 || static_cast<int8_t>(bytes[20]) < -1 ||
+            static_cast<int8_t>(bytes[20]) >= STACK_HEIGHT)
+        {
+            send("E01");
+            break;
+        }
+        DebugRegisters state;
+        std::memcpy(state.V, bytes.data(), REGISTER_COUNT);
+        state.I = static_cast<uint8_t>(bytes[16]) | static_cast<uint8_t>(bytes[17]) << 8;
+        state.PC = static_cast<uint8_t>(bytes[18]) | static_cast<uint8_t>(bytes[19]) << 8;
+        state.SP = static_cast<int8_t>(bytes[20]);
+        state.DT = bytes[21];
+        state.ST = bytes[22];
+        chip8.set_registers(state);
+        send("OK");
+        break;
+    }
+    case 'p':
+    {
+        sscanf(packet.c_str() + 1, "%x", &reg);
+        if (reg >= REG_COUNT)
+        {
+            send("E01");
+            break;
+        }
+        send(read_registers().substr(reg_offset(reg) * 2, reg_size(reg) * 2));
+        break;
+    }
+    case 'm':
+    {
+        // addr + length could wrap, so the length is compared with what's left
+        size_t size = chip8.memory_size();
+        if (sscanf(packet.c_str() + 1, "%x,%x", &addr, &length) != 2 || addr >= size || length > size - addr)
+        {
+            send("E01");
+            break;
+        }
+        send(hex(chip8.memory() + addr, length));
+        break;
+    }
+    case 'M':
+    {
+        size_t colon = packet.find(':');
+        size_t size = chip8.memory_size();
+        if (sscanf(packet.c_str() + 1, "%x,%x", &addr, &length) != 2 || colon == std::string::npos ||
+            addr >= size || length > size - addr)
+        {
+            send("E01");
+            break;
+        }
+        std::string data = unhex(packet.substr(colon + 1));
+        chip8.write_memory(addr, reinterpret_cast<const uint8_t *>(data.data()), std::min<size_t>(data.size(), length));
+        send("OK");
+        break;
+    }
+    case 'c':
+        chip8.resume();
+        running = true;
+        break;
+    case 's':
+        chip8.resume();
+        chip8.run(1);
+        send(stop_reply());
+        break;
+    case 'Z':
+    case 'z':
+    {
+        bool on = packet[0] == 'Z';
+        if (sscanf(packet.c_str() + 1, "%x,%x,%x", &type, &addr, &length) != 3 || addr >= chip8.memory_size())
+        {
+            send("E01");
+            break;
+        }
+        // software and hardware breakpoints are the same thing here, and
+        // only writes can be watched
+        if (type == 0 || type == 1)
+        {
+            chip8.set_breakpoint(addr, on);
+        }
+        else if (type == 2)
+        {
+            chip8.set_watchpoint(addr, length, on);
+        }
+        else
+        {
+            send("");
+            break;
+        }
+        send("OK");
+        break;
+    }
+    case 'q':
+        query(packet);
+        break;
+    case 'H':
+        send("OK");
+        break;
+    case 'D':
+        send("OK");
+        disconnect();
+        break;
+    case 'k':
+        killed = true;
+        disconnect();
+        break;
+    default:
+        send("");
+    }
+}
+
+void GdbStub::query(const std::string &packet)
+{
+    if (packet.rfind("qSupported", 0) == 0)
+    {
+        send("PacketSize=" + std::to_string(GDB_PACKET_SIZE) + ";qXfer:features:read+");
+    }
+    else if (packet.rfind("qXfer:features:read:target.xml:", 0) == 0)
+    {
+        unsigned offset = 0, length = 0;
+        sscanf(packet.c_str() + 31, "%x,%x", &offset, &length);
+        std::string xml = target_xml();
+        if (offset >= xml.size())
+        {
+            send("l");
+            return;
+        }
+        std::string part = xml.substr(offset, length);
+        send((offset + part.size() < xml.size() ? "m" : "l") + part);
+    }
+    else if (packet.rfind("qRcmd,", 0) == 0)
+    {
+        send(hex(monitor(unhex(packet.substr(6)))));
+    }
+    else if (packet == "qAttached")
+    {
+        send("1");
+    }
+    else if (packet == "qC")
+    {
+        send("QC1");
+    }
+    else if (packet == "qfThreadInfo")
+    {
+        send("m1");
+    }
+    else if (packet == "qsThreadInfo")
+    {
+        send("l");
+    }
+    else
+    {
+        send("");
+    }
+}
+
+// monitor dis [addr [count]], mem addr [length], watch reg, unwatch reg
+std::string GdbStub::monitor(const std::string &command)
+{
+    std::istringstream in(command);
+    std::string word, arg;
+    in >> word;
+    const uint8_t *ram = chip8.memory();
+    uint16_t pc = chip8.registers().PC;
+    char line[80];
+    std::string out;
+    if (word == "dis")
+    {
+        unsigned addr = pc, count = GDB_DIS_LINES;
+        if (in >> arg)
+        {
+            addr = strtoul(arg.c_str(), nullptr, 16);
+        }
+        if (in >> arg)
+        {
+            count = strtoul(arg.c_str(), nullptr, 0);
+        }
+        for (unsigned i = 0; i < count && addr < chip8.memory_size() - 1; ++i, addr += 2)
+        {
+            uint16_t instruction = ram[addr] << 8 | ram[addr + 1];
+            snprintf(line, sizeof(line), "%s%04X  %04X  %s\n", addr == pc ? "=> " : "   ", addr,
+                     instruction, disassemble(instruction).c_str());
+            out += line;
+        }
+    }
+    else if (word == "mem" && in >> arg)
+    {
+        unsigned addr = strtoul(arg.c_str(), nullptr, 16), length = GDB_MEM_BYTES;
+        if (in >> arg)
+        {
+            length = strtoul(arg.c_str(), nullptr, 0);
+        }
+        // clamped to memory before adding, so the end can't wrap
+        size_t size = chip8.memory_size();
+        size_t end = addr < size ? addr + std::min<size_t>(length, size - addr) : addr;
+        for (size_t row = addr; row < end; row += 16)
+        {
+            snprintf(line, sizeof(line), "%04X ", static_cast<unsigned>(row));
+            out += line;
+            for (size_t a = row; a < row + 16 && a < end; ++a)
+            {
+                snprintf(line, sizeof(line), " %02X", ram[a]);
+                out += line;
+            }
+            out += "\n";
+        }
+    }
+    else if ((word == "watch" || word == "unwatch") && in >> arg)
+    {
+        // register watchpoints run the machine one instruction at a time
+        int reg = -1;
+        for (int r = 0; r <= REG_I; ++r)
+        {
+            if (arg == REG_NAMES[r])
+            {
+                reg = r;
+            }
+        }
+        if (reg < 0)
+        {
+            return "registers are v0-vf and i\n";
+        }
+        uint32_t mask = chip8.watched_registers();
+        mask = word == "watch" ? mask | 1 << reg : mask & ~(1 << reg);
+        chip8.watch_registers(mask);
+    }
+    else
+    {
+        out = "monitor dis [addr [count]], mem addr [length], watch reg, unwatch reg\n";
+    }
+    return out;
+}
@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <string>
+#include "CHIP8.h"
+
+#ifndef GDB_STUB_H
+#define GDB_STUB_H
+
+#define GDB_PACKET_SIZE 4096
+// monitor dis and mem without a count
+#define GDB_DIS_LINES 10
+#define GDB_MEM_BYTES 64
+
+// GDB remote serial protocol on a loopback TCP port, or a Unix socket when
+// the address has a '/' in it. one client, all-stop: the machine is stopped
+// when the client connects and only runs between its continue and the next
+// breakpoint, watchpoint or ^C. registers are V0-VF, I, PC, SP, DT and ST;
+// disassembly, memory dumps and register watchpoints are monitor commands.
+class GdbStub
+{
+private:
+    CHIP8 &chip8;
+    int client = -1;
+    bool running = false;
+    bool killed = false;
+    // bytes read but not handled yet
+    std::string input;
+
+    int read_byte(bool block);
+    bool read_packet(std::string &packet);
+    void send(const std::string &data);
+    void handle(const std::string &packet);
+    void query(const std::string &packet);
+    std::string monitor(const std::string &command);
+    std::string read_registers();
+    std::string stop_reply();
+    void disconnect();
+
+public:
+    // blocks until a client connects
+    GdbStub(CHIP8 &c, const std::string &address);
+    ~GdbStub();
+    // call before each frame: serves the client for as long as the machine
+    // is stopped. false once the client has killed it, after a detach the
+    // machine runs free
+    bool poll();
+    // from another thread, ends the session so a poll blocked on the
+    // client returns
+    void hang_up();
+};
+
+#endif // GDB_STUB_H
@@ -0,0 +1,444 @@
+#include "JIT.h"
+#include "Profile.h"
+#include <cstdlib>
+#include <cstring>
+#ifdef JIT_X86_64
+#include <sys/mman.h>
+#endif
+
+// guest state is addressed off rdi (the CHIP8 object), the remaining
+// instruction budget lives in esi and IC is kept in dx while a block runs.
+// every block returns the budget left over in eax, and a block that doesn't
+// fit in the budget returns without running so the caller never overshoots.
+typedef int32_t (*Block)(CHIP8 *chip8, int32_t budget);
+
+JIT::JIT(CHIP8 &c) : chip8(c)
+{
+    v_offset = reinterpret_cast<uint8_t *>(c.V) - reinterpret_cast<uint8_t *>(&c);
+    ic_offset = reinterpret_cast<uint8_t *>(&c.IC) - reinterpret_cast<uint8_t *>(&c);
+    pc_offset = reinterpret_cast<uint8_t *>(&c.PC) - reinterpret_cast<uint8_t *>(&c);
+    dt_offset = reinterpret_cast<uint8_t *>(&c.DTIME) - reinterpret_cast<uint8_t *>(&c);
+#ifdef JIT_X86_64
+    // never writable and executable at once, compile opens it up while it emits
+    void *mem = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem != MAP_FAILED)
+    {
+        code = static_cast<uint8_t *>(mem);
+        reset();
+        // a host that won't map it executable has no jit
+        if (mprotect(code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(code, JIT_CODE_SIZE);
+            code = nullptr;
+        }
+    }
+#endif
+}
+
+JIT::~JIT()
+{
+#ifdef JIT_X86_64
+    if (code != nullptr)
+    {
+        munmap(code, JIT_CODE_SIZE);
+    }
+#endif
+}
+
+bool JIT::available()
+{
+    return code != nullptr;
+}
+
+void JIT::flush()
+{
+    if (code == nullptr)
+    {
+        return;
+    }
+    protect(true);
+    reset();
+    protect(false);
+}
+
+// the buffer is either writable or executable, switched around every write
+void JIT::protect(bool writable)
+{
+#ifdef JIT_X86_64
+    if (mprotect(code, JIT_CODE_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0)
+    {
+        std::cout << "cannot change jit code protection\n";
+        exit(1);
+    }
+#endif
+}
+
+// forgets every block, the buffer has to be writable
+void JIT::reset()
+{
+    std::fill(blocks, blocks + RAM_SIZE, nullptr);
+    std::fill(covered, covered + RAM_SIZE, false);
+    std::fill(failed, failed + RAM_SIZE, false);
+    links.clear();
+    used = 0;
+    // shared block epilogue: mov eax, esi; ret
+    ret_stub = code;
+    emit({0x89, 0xF0, 0xC3});
+}
+
+void JIT::invalidate(uint16_t addr)
+{
+    addr &= RAM_SIZE - 1;
+    if (covered[addr])
+    {
+        flush();
+        return;
+    }
+    failed[addr] = false;
+    failed[(addr - 1) & (RAM_SIZE - 1)] = false;
+}
+
+uint64_t JIT::run(uint64_t budget)
+{
+    if (code == nullptr || chip8.PC >= RAM_SIZE - 1)
+    {
+        return 0;
+    }
+    uint8_t *entry = blocks[chip8.PC];
+    if (entry == nullptr)
+    {
+        if (failed[chip8.PC])
+        {
+            return 0;
+        }
+        entry = compile(chip8.PC);
+        if (entry == nullptr)
+        {
+            failed[chip8.PC] = true;
+            return 0;
+        }
+    }
+    int32_t b = budget > INT32_MAX ? INT32_MAX : budget;
+    int32_t left = reinterpret_cast<Block>(entry)(&chip8, b);
+    return b - left;
+}
+
+void JIT::emit(std::initializer_list<uint8_t> bytes)
+{
+    for (uint8_t b : bytes)
+    {
+        code[used++] = b;
+    }
+}
+
+void JIT::emit32(uint32_t value)
+{
+    std::memcpy(code + used, &value, 4);
+    used += 4;
+}
+
+// nothing is live in rax between guest instructions
+void JIT::emit_count(uint64_t *counter)
+{
+    uint64_t addr = reinterpret_cast<uintptr_t>(counter);
+    emit({0x48, 0xB8}); // mov rax, counter
+    emit32(static_cast<uint32_t>(addr));
+    emit32(static_cast<uint32_t>(addr >> 32));
+    emit({0x48, 0xFF, 0x00}); // inc qword [rax]
+}
+
+void JIT::link(uint8_t *site, uint8_t *target)
+{
+    int32_t rel = target - (site + 4);
+    std::memcpy(site, &rel, 4);
+}
+
+// writes PC (and IC if the block changed it), charges the block against the
+// budget and either returns or jumps straight into the target block
+void JIT::emit_exit(uint16_t target, int count, bool uses_ic)
+{
+    if (uses_ic)
+    {
+        emit({0x66, 0x89, 0x97}); // mov [rdi+ic], dx
+        emit32(ic_offset);
+    }
+    emit({0x66, 0xC7, 0x87}); // mov word [rdi+pc], target
+    emit32(pc_offset);
+    emit({static_cast<uint8_t>(target), static_cast<uint8_t>(target >> 8)});
+    emit({0x81, 0xEE}); // sub esi, count
+    emit32(count);
+    emit({0x0F, 0x8E}); // jle ret_stub
+    link(code + used, ret_stub);
+    used += 4;
+    emit({0xE9}); // jmp target block, or ret_stub until it exists
+    uint8_t *site = code + used;
+    used += 4;
+    if (target < RAM_SIZE && blocks[target] != nullptr)
+    {
+        link(site, blocks[target]);
+    }
+    else
+    {
+        link(site, ret_stub);
+        links[target].push_back(site);
+    }
+}
+
+uint8_t *JIT::compile(uint16_t pc)
+{
+    protect(true);
+    // worst case per instruction, plus the checks and two exits
+    if (used + JIT_MAX_BLOCK * JIT_MAX_INSTRUCTION + 128 > JIT_CODE_SIZE)
+    {
+        reset();
+    }
+    uint8_t *entry = code + used;
+    uint16_t start = pc;
+    int count = 0;
+    bool uses_ic = false;
+    bool ended = false;
+    auto vx = [this](uint8_t reg) { return static_cast<uint32_t>(v_offset + reg); };
+    auto vf = vx(0xF);
+
+    emit({0x81, 0xFE}); // cmp esi, count (patched once the block is done)
+    uint8_t *size_check = code + used;
+    used += 4;
+    emit({0x0F, 0x8C}); // jl ret_stub
+    link(code + used, ret_stub);
+    used += 4;
+
+    // IC is loaded lazily, so peek ahead to see if the block needs it
+    for (uint16_t a = pc; a < RAM_SIZE - 1 && a < pc + 2 * JIT_MAX_BLOCK; a += 2)
+    {
+        uint16_t ins = chip8.RAM[a] << 8 | chip8.RAM[a + 1];
+        if ((ins & 0xF000) == 0xA000 || (ins & 0xF0FF) == 0xF01E)
+        {
+            uses_ic = true;
+            break;
+        }
+    }
+    if (uses_ic)
+    {
+        emit({0x0F, 0xB7, 0x97}); // movzx edx, word [rdi+ic]
+        emit32(ic_offset);
+    }
+
+    while (!ended && count < JIT_MAX_BLOCK && pc < RAM_SIZE - 1)
+    {
+        // a block ends in front of a breakpoint, and the interpreter traps there
+        if (chip8.debugger != nullptr && chip8.debugger->breaks(pc))
+        {
+            if (count == 0)
+            {
+                used = entry - code;
+                protect(false);
+                return nullptr;
+            }
+            emit_exit(pc, count, uses_ic);
+            ended = true;
+            break;
+        }
+        uint16_t ins = chip8.RAM[pc] << 8 | chip8.RAM[pc + 1];
+        uint8_t x = (ins >> 8) & 0xF;
+        uint8_t y = (ins >> 4) & 0xF;
+        uint8_t kk = ins & 0xFF;
+        uint16_t nnn = ins & 0x0FFF;
+        size_t mark = used;
+        bool native = true;
+#ifdef CHIP8_PROFILE
+        emit_count(&chip8.profile->pc_hits[pc]);
+        emit_count(&chip8.profile->op_hits[ins]);
+#endif
+        switch (ins >> 12)
+        {
+        case 0x1:
+            // JP nnn
+            ++count;
+            emit_exit(nnn, count, uses_ic);
+            ended = true;
+            break;
+        case 0x3:
+        case 0x4:
+        case 0x5:
+        case 0x9:
+        {
+            if (((ins >> 12) == 0x5 || (ins >> 12) == 0x9) && (ins & 0xF) != 0)
+            {
+                native = false;
+                break;
+            }
+            if ((ins >> 12) == 0x3 || (ins >> 12) == 0x4)
+            {
+                emit({0x80, 0xBF}); // cmp byte [rdi+vx], kk
+                emit32(vx(x));
+                emit({kk});
+            }
+            else
+            {
+                emit({0x8A, 0x87}); // mov al, [rdi+vx]
+                emit32(vx(x));
+                emit({0x3A, 0x87}); // cmp al, [rdi+vy]
+                emit32(vx(y));
+            }
+            bool skip_on_equal = (ins >> 12) == 0x3 || (ins >> 12) == 0x5;
+            emit({0x0F, static_cast<uint8_t>(skip_on_equal ? 0x84 : 0x85)}); // je/jne skipped
+            uint8_t *skipped = code + used;
+            used += 4;
+            ++count;
+            emit_exit(pc + 2, count, uses_ic);
+            link(skipped, code + used);
+            emit_exit(pc + 4, count, uses_ic);
+            ended = true;
+            break;
+        }
+        case 0x6:
+            emit({0xC6, 0x87}); // mov byte [rdi+vx], kk
+            emit32(vx(x));
+            emit({kk});
+            break;
+        case 0x7:
+            emit({0x80, 0x87}); // add byte [rdi+vx], kk
+            emit32(vx(x));
+            emit({kk});
+            break;
+        case 0x8:
+            switch (ins & 0xF)
+            {
+            case 0x0:
+            case 0x1:
+            case 0x2:
+            case 0x3:
+            {
+                static const uint8_t ops[] = {0x88, 0x08, 0x20, 0x30}; // mov/or/and/xor [rdi+vx], al
+                emit({0x8A, 0x87}); // mov al, [rdi+vy]
+                emit32(vx(y));
+                emit({ops[ins & 0xF], 0x87});
+                emit32(vx(x));
+                break;
+            }
+            case 0x4:
+            case 0x5:
+            case 0x7:
+            {
+                // ADDC/SUB/SUBN, VF is written before Vx like the interpreter does
+                uint8_t first = (ins & 0xF) == 0x7 ? y : x;
+                uint8_t second = (ins & 0xF) == 0x7 ? x : y;
+                emit({0x8A, 0x87}); // mov al, [rdi+first]
+                emit32(vx(first));
+                emit({static_cast<uint8_t>((ins & 0xF) == 0x4 ? 0x02 : 0x2A), 0x87}); // add/sub al, [rdi+second]
+                emit32(vx(second));
+                emit({0x0F, static_cast<uint8_t>((ins & 0xF) == 0x4 ? 0x92 : 0x93), 0xC1}); // setc/setnc cl
+                emit({0x88, 0x8F}); // mov [rdi+vf], cl
+                emit32(vf);
+                emit({0x88, 0x87}); // mov [rdi+vx], al
+                emit32(vx(x));
+                break;
+            }
+            case 0x6:
+            case 0xE:
+            {
+                bool right = (ins & 0xF) == 0x6;
+                if (chip8.quirks.shift_vy)
+                {
+                    emit({0x8A, 0x87}); // mov al, [rdi+vy]
+                    emit32(vx(y));
+                    emit({0x88, 0x87}); // mov [rdi+vx], al
+                    emit32(vx(x));
+                }
+                emit({0x8A, 0x87}); // mov al, [rdi+vx]
+                emit32(vx(x));
+                if (right)
+                {
+                    emit({0x24, 0x01}); // and al, 1
+                }
+                else
+                {
+                    emit({0xC0, 0xE8, 0x07}); // shr al, 7
+                }
+                emit({0x88, 0x87}); // mov [rdi+vf], al
+                emit32(vf);
+                emit({0x8A, 0x87}); // mov al, [rdi+vx]
+                emit32(vx(x));
+                emit({0xD0, static_cast<uint8_t>(right ? 0xE8 : 0xE0)}); // shr/shl al, 1
+                emit({0x88, 0x87}); // mov [rdi+vx], al
+                emit32(vx(x));
+                break;
+            }
+            default:
+                native = false;
+            }
+            break;
+        case 0xA:
+            emit({0xBA}); // mov edx, nnn
+            emit32(nnn);
+            break;
+        case 0xF:
+            if (kk == 0x07)
+            {
+                emit({0x8A, 0x87}); // mov al, [rdi+dtime]
+                emit32(dt_offset);
+                emit({0x88, 0x87}); // mov [rdi+vx], al
+                emit32(vx(x));
+            }
+            else if (kk == 0x1E)
+            {
+                emit({0x0F, 0xB6, 0x87}); // movzx eax, byte [rdi+vx]
+                emit32(vx(x));
+                emit({0x66, 0x01, 0xC2}); // add dx, ax
+                if (chip8.quirks.add_i_carry)
+                {
+                    emit({0x66, 0x81, 0xFA, 0xFF, 0x0F}); // cmp dx, 0xFFF
+                    emit({0x76, 0x07});                   // jbe past the store
+                    emit({0xC6, 0x87});                   // mov byte [rdi+vf], 1
+                    emit32(vf);
+                    emit({0x01});
+                }
+            }
+            else
+            {
+                native = false;
+            }
+            break;
+        default:
+            native = false;
+        }
+        if (!native)
+        {
+            used = mark;
+            if (count == 0)
+            {
+                used = entry - code;
+                protect(false);
+                return nullptr;
+            }
+            emit_exit(pc, count, uses_ic);
+            ended = true;
+            break;
+        }
+        covered[pc] = true;
+        covered[pc + 1] = true;
+        if (!ended)
+        {
+            ++count;
+            pc += 2;
+        }
+    }
+    if (!ended)
+    {
+        emit_exit(pc, count, uses_ic);
+    }
+    std::memcpy(size_check, &count, 4);
+
+    blocks[start] = entry;
+    auto waiting = links.find(start);
+    if (waiting != links.end())
+    {
+        for (uint8_t *site : waiting->second)
+        {
+            link(site, entry);
+        }
+        links.erase(waiting);
+    }
+    protect(false);
+    return entry;
+}
@@ -0,0 +1,70 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <unordered_map>
+#include "CHIP8.h"
+
+#ifndef JIT_H
+#define JIT_H
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define JIT_X86_64
+#endif
+
+#define JIT_CODE_SIZE (1 << 20)
+#define JIT_MAX_BLOCK 64
+// worst case code per guest instruction, an 8xy6/8xyE that copies Vy first
+// (shift_vy) at 41 bytes, and the profile counters add 26
+#ifdef CHIP8_PROFILE
+#define JIT_MAX_INSTRUCTION 67
+#else
+#define JIT_MAX_INSTRUCTION 41
+#endif
+
+// translates straight-line runs of CHIP-8 code into x86-64. a block ends at
+// the first instruction that has to go through the interpreter, or at a
+// jump/skip, whose exits chain directly into the target block once that
+// target has been translated.
+class JIT
+{
+private:
+    CHIP8 &chip8;
+    // read and execute, only writable inside compile and flush
+    uint8_t *code = nullptr;
+    size_t used = 0;
+    uint8_t *ret_stub = nullptr;
+    // translated entry point per guest address
+    uint8_t *blocks[RAM_SIZE] = {nullptr};
+    // guest addresses covered by some block, and entry points that can't be translated
+    bool covered[RAM_SIZE] = {false};
+    bool failed[RAM_SIZE] = {false};
+    // jmp rel32 sites waiting for a block to be translated at the keyed address
+    std::unordered_map<uint16_t, std::vector<uint8_t *>> links;
+    // offsets of guest state inside the CHIP8 object
+    int32_t v_offset;
+    int32_t ic_offset;
+    int32_t pc_offset;
+    int32_t dt_offset;
+
+    uint8_t *compile(uint16_t pc);
+    void emit(std::initializer_list<uint8_t> bytes);
+    void emit32(uint32_t value);
+    void emit_count(uint64_t *counter);
+    void emit_exit(uint16_t target, int count, bool uses_ic);
+    void link(uint8_t *site, uint8_t *target);
+    void protect(bool writable);
+    void reset();
+
+public:
+    JIT(CHIP8 &c);
+    ~JIT();
+    bool available();
+    // runs translated code from the current PC without going over budget,
+    // returns instructions executed or 0 when the interpreter has to step
+    uint64_t run(uint64_t budget);
+    // called when guest code writes to addr
+    void invalidate(uint16_t addr);
+    void flush();
+};
+
+#endif // JIT_H
@@ -1,20 +1,84 @@
 #include <stdint.h>
 #include <iostream>
-#include <SDL2/SDL_events.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "SPSCRing.h"
 #ifndef KEYPAD_H
 #define KEYPAD_H
 #define KEYCOUNT 16
+#define NO_KEY 0xEE
+#define QUIT_KEY 0xFF
+#define INPUT_QUEUE_SIZE 64
+
+// what the thread that owns the input device saw: every held key, and the
+// last key that went down
+struct KeyState {
+    uint16_t held;
+    uint8_t pressed;
+};
 
 class Keypad {
-    private:
+    protected:
     bool KEYS[KEYCOUNT] = {false};
-    SDL_Event e;
     uint8_t toggle(uint8_t key, bool up);
+    // bit n of held is key n
+    void setHeld(uint16_t held);
     public:
+    virtual ~Keypad() = default;
     bool getKey(uint8_t key);
     bool isPressed();
-    void updateKeypad();
-    uint8_t handleEvents();
+    // bit n set while key n is held
+    uint16_t heldKeys();
+    // drains pending input, returns the last key that went down, NO_KEY if
+    // none, QUIT_KEY on quit
+    virtual uint8_t handleEvents() = 0;
+    // same, but blocks up to timeout ms for the first event
+    virtual uint8_t waitEvents(uint32_t timeout) { return handleEvents(); }
+};
+
+// input backend with no device attached, keys stay released
+class NullKeypad : public Keypad {
+    public:
+    uint8_t handleEvents() override { return NO_KEY; }
+};
+
+// key states from the thread that owns the input device, through an SPSC
+// ring. pop is lock-free, push briefly takes the lock the consumer sleeps
+// on so a key can't land between its check and its wait and be missed
+class KeyQueue {
+    private:
+    SPSCRing<KeyState, INPUT_QUEUE_SIZE> ring;
+    std::mutex lock;
+    std::condition_variable arrived;
+    public:
+    bool push(const KeyState &state) {
+        if(!ring.push(state)) {
+            return false;
+        }
+        // held for no work: a waiter is either before its check, and sees the
+        // key, or already asleep, and gets the notify
+        { std::lock_guard<std::mutex> hold(lock); }
+        arrived.notify_one();
+        return true;
+    }
+    bool pop(KeyState &state) { return ring.pop(state); }
+    // false if nothing arrived within timeout ms
+    bool wait(uint32_t timeout) {
+        std::unique_lock<std::mutex> hold(lock);
+        return arrived.wait_for(hold, std::chrono::milliseconds(timeout), [this] { return ring.size() > 0; });
+    }
+};
+
+// input produced on another thread, handed over through a KeyQueue
+class QueueKeypad : public Keypad {
+    private:
+    KeyQueue &queue;
+    public:
+    QueueKeypad(KeyQueue &q) : queue(q) {}
+    uint8_t handleEvents() override;
+    // sleeps until the input thread pushes, so a parked Fx0A wakes on the key
+    uint8_t waitEvents(uint32_t timeout) override;
 };
 
-#endif
\ No newline at end of file
+#endif
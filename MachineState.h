@@ -0,0 +1,73 @@
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+#include "Framebuffer.h"
+
+#ifndef MACHINE_STATE_H
+#define MACHINE_STATE_H
+
+#define ROM_START 0x200
+#define RAM_SIZE 0x1000
+// XO-CHIP's address space, only allocated while XO-CHIP is selected
+#define XO_RAM_SIZE 0x10000
+#define REGISTER_COUNT 16
+#define STACK_HEIGHT 16
+// SUPER-CHIP user flags, XO-CHIP has all 16
+#define RPL_COUNT 16
+
+#define STATE_MAGIC 0x53384B52 // "RK8S"
+#define STATE_VERSION 4
+
+// everything that makes up a running machine except XO-CHIP's memory,
+// kept in one trivially copyable block so a snapshot is a single copy
+struct MachineCore
+{
+    // memory of CHIP-8 and SUPER-CHIP
+    uint8_t RAM[RAM_SIZE];
+    // program counter
+    uint16_t PC;
+    // index counter
+    uint16_t IC;
+    // registers
+    uint8_t V[REGISTER_COUNT];
+    // stack
+    uint16_t STACK[STACK_HEIGHT];
+    // stack pointer
+    int32_t SP;
+    // timers
+    uint8_t DTIME = 0;
+    uint8_t STIME = 0;
+    // Fx0A parked the machine until a key goes down, the key lands in V[wait_reg]
+    bool waiting = false;
+    uint8_t wait_reg = 0;
+    // Fx75/Fx85 flag registers
+    uint8_t RPL[RPL_COUNT] = {0};
+    // XO-CHIP bitplanes that draw, clear and scroll touch, a mask
+    uint8_t planes = 0x1;
+    // emulated time, timers tick when cycles reaches next_tick
+    uint64_t cycles = 0;
+    uint64_t next_tick = 10;
+    // xorshift state for RND
+    uint64_t rng;
+    // screen, packed words per row and plane
+    Framebuffer fb;
+};
+static_assert(std::is_trivially_copyable<MachineCore>::value, "snapshots are plain copies");
+
+struct MachineState : MachineCore
+{
+    // XO-CHIP's memory in place of RAM, empty on the other variants
+    std::vector<uint8_t> XO_RAM;
+};
+
+// on-disk save state: this header, the raw MachineCore, then xo_size
+// bytes of XO-CHIP memory
+struct StateHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t xo_size;
+};
+
+#endif // MACHINE_STATE_H
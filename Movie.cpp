@@ -0,0 +1,164 @@
+#include "Movie.h"
+#include "CHIP8.h"
+#include <cstdlib>
+#include <fstream>
+
+static void put(std::ofstream &out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+    {
+        out.put(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+static uint64_t get(std::ifstream &in, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+    {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(in.get())) << (8 * i);
+    }
+    return value;
+}
+
+void Movie::save(char const *filename) const
+{
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open())
+    {
+        std::cout << "cannot open file\n";
+        exit(1);
+    }
+    put(out, MOVIE_MAGIC, 4);
+    put(out, MOVIE_VERSION, 4);
+    out.write(reinterpret_cast<const char *>(rom_sha1), SHA1_SIZE);
+    put(out, seed, 8);
+    put(out, ipf, 8);
+    put(out, frames, 8);
+    put(out, variant, 1);
+    put(out, quirks, 1);
+    put(out, events.size(), 4);
+    uint64_t frame = 0;
+    for (auto &e : events)
+    {
+        uint64_t delta = e.frame - frame;
+        frame = e.frame;
+        do
+        {
+            out.put(static_cast<char>((delta & 0x7F) | (delta > 0x7F ? 0x80 : 0)));
+            delta >>= 7;
+        } while (delta != 0);
+        put(out, e.held, 2);
+        put(out, e.pressed, 1);
+    }
+}
+
+void Movie::load(char const *filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open())
+    {
+        std::cout << "cannot open file\n";
+        exit(1);
+    }
+    uint32_t magic = get(in, 4);
+    uint32_t version = get(in, 4);
+    in.read(reinterpret_cast<char *>(rom_sha1), SHA1_SIZE);
+    seed = get(in, 8);
+    ipf = get(in, 8);
+    frames = get(in, 8);
+    variant = get(in, 1);
+    quirks = get(in, 1);
+    uint32_t count = get(in, 4);
+    if (!in || magic != MOVIE_MAGIC || version != MOVIE_VERSION)
+    {
+        std::cout << "not a movie for this version\n";
+        exit(1);
+    }
+    // both index tables in the core
+    if (variant >= VARIANTS || quirks >= QUIRK_PROFILES)
+    {
+        std::cout << "movie has a bad variant or quirk profile\n";
+        exit(1);
+    }
+    events.clear();
+    uint64_t frame = 0;
+    for (uint32_t i = 0; i < count && in; ++i)
+    {
+        uint64_t delta = 0;
+        for (int shift = 0; in; shift += 7)
+        {
+            if (shift >= 64)
+            {
+                std::cout << "movie has a bad frame delta\n";
+                exit(1);
+            }
+            uint8_t byte = in.get();
+            delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                break;
+            }
+        }
+        frame += delta;
+        uint16_t held = get(in, 2);
+        uint8_t pressed = get(in, 1);
+        events.push_back({frame, held, pressed});
+    }
+    if (!in)
+    {
+        std::cout << "movie is truncated\n";
+        exit(1);
+    }
+}
+
+// only changes are kept, and changes at the same boundary fold into one:
+// the last held mask wins, and the first key down is the one a waiting
+// Fx0A would have taken
+uint8_t RecordKeypad::record(uint8_t key)
+{
+    uint16_t held = inner->heldKeys();
+    setHeld(held);
+    if (key == QUIT_KEY || (key == NO_KEY && held == last_held))
+    {
+        return key;
+    }
+    last_held = held;
+    if (!movie.events.empty() && movie.events.back().frame == movie.frames)
+    {
+        MovieEvent &e = movie.events.back();
+        e.held = held;
+        if (e.pressed == NO_KEY)
+        {
+            e.pressed = key;
+        }
+    }
+    else
+    {
+        movie.events.push_back({movie.frames, held, key});
+    }
+    return key;
+}
+
+uint8_t RecordKeypad::handleEvents() {
+    uint8_t key = record(inner->handleEvents());
+    ++movie.frames;
+    return key;
+}
+
+uint8_t RecordKeypad::waitEvents(uint32_t timeout) {
+    return record(inner->waitEvents(timeout));
+}
+
+uint8_t MovieKeypad::handleEvents() {
+    uint8_t key = NO_KEY;
+    while (next < movie.events.size() && movie.events[next].frame <= frame) {
+        setHeld(movie.events[next].held);
+        if (key == NO_KEY) {
+            key = movie.events[next].pressed;
+        }
+        ++next;
+    }
+    ++frame;
+    return key;
+}
@@ -0,0 +1,69 @@
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "Keypad.h"
+#include "Sha1.h"
+
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#define MOVIE_MAGIC 0x4D384B52 // "RK8M"
+#define MOVIE_VERSION 2
+
+// input at one frame boundary: the keys held once it is applied, and the
+// key that went down (NO_KEY if only releases happened)
+struct MovieEvent
+{
+    uint64_t frame;
+    uint16_t held;
+    uint8_t pressed;
+};
+
+// what it takes to replay a session bit for bit: the ROM, seed, speed,
+// instruction set and quirk profile it ran with, and the input as it reached
+// the machine. on disk a fixed header is followed by one record per event: the frame
+// delta as a LEB128 varint, the held mask (little-endian) and the pressed key.
+struct Movie
+{
+    uint8_t rom_sha1[SHA1_SIZE] = {0};
+    uint64_t seed = 0;
+    uint64_t ipf = 10;
+    uint8_t variant = 0;
+    uint8_t quirks = 0;
+    // frames recorded, replay runs exactly this many
+    uint64_t frames = 0;
+    std::vector<MovieEvent> events;
+
+    void save(char const *filename) const;
+    void load(char const *filename);
+};
+
+// passes another keypad through and writes down every change the machine
+// sees. each handleEvents() is a frame, waitEvents() lands on the boundary
+// before the next one.
+class RecordKeypad : public Keypad {
+    private:
+    std::unique_ptr<Keypad> inner;
+    Movie &movie;
+    uint16_t last_held = 0;
+    uint8_t record(uint8_t key);
+    public:
+    RecordKeypad(std::unique_ptr<Keypad> k, Movie &m) : inner(std::move(k)), movie(m) {}
+    uint8_t handleEvents() override;
+    uint8_t waitEvents(uint32_t timeout) override;
+};
+
+// plays a movie back one frame per handleEvents(), ignoring the host
+class MovieKeypad : public Keypad {
+    private:
+    const Movie &movie;
+    size_t next = 0;
+    uint64_t frame = 0;
+    public:
+    MovieKeypad(const Movie &m) : movie(m) {}
+    uint8_t handleEvents() override;
+    // nothing arrives between frames, the input is already in the movie
+    uint8_t waitEvents(uint32_t timeout) override { return NO_KEY; }
+};
+
+#endif // MOVIE_H
@@ -0,0 +1,86 @@
+#include "Profile.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Disasm.h"
+
+void Profile::end_frame()
+{
+    ++frames;
+    max_frame_draws = std::max(max_frame_draws, frame_draws);
+    collision_frames += frame_collided;
+    frame_draws = 0;
+    frame_collided = false;
+}
+
+static double percent(uint64_t part, uint64_t whole)
+{
+    return whole == 0 ? 0.0 : 100.0 * part / whole;
+}
+
+void Profile::report(std::ostream &out, const uint8_t *ram, uint16_t ram_mask) const
+{
+    char line[96];
+    uint64_t total = 0;
+    // the mnemonic is the class, operands are dropped
+    std::map<std::string, uint64_t> classes;
+    for (uint32_t i = 0; i < 0x10000; ++i)
+    {
+        if (op_hits[i] == 0)
+        {
+            continue;
+        }
+        total += op_hits[i];
+        std::string text = disassemble(i);
+        classes[text.substr(0, text.find(' '))] += op_hits[i];
+    }
+    std::vector<std::pair<uint64_t, std::string>> by_class;
+    for (const auto &c : classes)
+    {
+        by_class.push_back({c.second, c.first});
+    }
+    std::sort(by_class.rbegin(), by_class.rend());
+
+    std::vector<std::pair<uint64_t, uint32_t>> by_pc;
+    for (uint32_t pc = 0; pc <= ram_mask; ++pc)
+    {
+        if (pc_hits[pc] != 0)
+        {
+            by_pc.push_back({pc_hits[pc], pc});
+        }
+    }
+    size_t hot = std::min<size_t>(by_pc.size(), PROFILE_TOP);
+    std::partial_sort(by_pc.begin(), by_pc.begin() + hot, by_pc.end(),
+                      [](const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b)
+                      { return a.first > b.first || (a.first == b.first && a.second < b.second); });
+
+    out << "profile: " << total << " instructions, " << frames << " frames, "
+        << by_pc.size() << " addresses run\n";
+    out << "classes\n";
+    for (const auto &c : by_class)
+    {
+        snprintf(line, sizeof(line), "  %-6s %14llu %6.2f%%\n", c.second.c_str(),
+                 static_cast<unsigned long long>(c.first), percent(c.first, total));
+        out << line;
+    }
+    out << "hot addresses\n";
+    for (size_t i = 0; i < hot; ++i)
+    {
+        uint16_t pc = by_pc[i].second;
+        uint16_t instruction = ram[pc] << 8 | ram[(pc + 1) & ram_mask];
+        snprintf(line, sizeof(line), "  %04X %14llu %6.2f%%  %04X  %s\n", pc,
+                 static_cast<unsigned long long>(by_pc[i].first), percent(by_pc[i].first, total),
+                 instruction, disassemble(instruction).c_str());
+        out << line;
+    }
+    snprintf(line, sizeof(line), "draws: %llu, %.2f per frame, at most %llu in a frame\n",
+             static_cast<unsigned long long>(draws), frames == 0 ? 0.0 : static_cast<double>(draws) / frames,
+             static_cast<unsigned long long>(max_frame_draws));
+    out << line;
+    snprintf(line, sizeof(line), "collisions: %.2f%% of draws, in %.2f%% of frames\n",
+             percent(collisions, draws), percent(collision_frames, frames));
+    out << line;
+}
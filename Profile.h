@@ -0,0 +1,52 @@
+#include <stdint.h>
+#include <ostream>
+#include "MachineState.h"
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// rows in each table of the report
+#define PROFILE_TOP 20
+
+// execution counters for one machine. CHIP8 only keeps one when built with
+// -DCHIP8_PROFILE, and the hot path is two increments per instruction, so
+// opcode classes are worked out from the instruction words at report time.
+struct Profile
+{
+    // executions per address and per instruction word
+    uint64_t pc_hits[XO_RAM_SIZE] = {0};
+    uint64_t op_hits[0x10000] = {0};
+    // a frame is one timer tick
+    uint64_t frames = 0;
+    uint64_t draws = 0;
+    uint64_t collisions = 0;
+    uint64_t frame_draws = 0;
+    uint64_t max_frame_draws = 0;
+    uint64_t collision_frames = 0;
+    bool frame_collided = false;
+
+    void hit(uint16_t pc, uint16_t instruction)
+    {
+        ++pc_hits[pc];
+        ++op_hits[instruction];
+    }
+    // an idle loop skipped in one go
+    void hit(uint16_t pc, uint16_t instruction, uint64_t times)
+    {
+        pc_hits[pc] += times;
+        op_hits[instruction] += times;
+    }
+    void draw(bool collision)
+    {
+        ++draws;
+        ++frame_draws;
+        collisions += collision;
+        frame_collided |= collision;
+    }
+    void end_frame();
+    // instruction classes and hot addresses by count, the addresses are
+    // disassembled from memory as it is now
+    void report(std::ostream &out, const uint8_t *ram, uint16_t ram_mask) const;
+};
+
+#endif // PROFILE_H
@@ -0,0 +1,52 @@
+#include "Quirks.h"
+
+static const char *const NAMES[QUIRK_PROFILES] = {"modern", "vip", "chip48", "schip"};
+
+// ROMs checked against a profile, by SHA-1 of the whole image. anything
+// not listed runs as MODERN
+static const struct
+{
+    const char *sha1;
+    QuirkProfile profile;
+} KNOWN_ROMS[] = {
+    // roms/, the regress goldens were recorded with these. an unsuffixed
+    // golden entry runs under the profile listed here
+    {"31fc1c53cc610a9f4b9c5705c5a0f33fc028d123", QuirkProfile::MODERN}, // br8kout.ch8, Octojam
+    {"f9ad6ba27ce0efd1d2a0e5d25b732796c8afeb6f", QuirkProfile::MODERN}, // chip8-test-rom.ch8
+    {"1ba58656810b67fd131eb9af3e3987863bf26c90", QuirkProfile::VIP},    // ibm.ch8, the COSMAC VIP logo demo
+    {"b232ef880bd6060fb45fa6effed7edf0ae95670e", QuirkProfile::CHIP48}, // pong.rom, Vervalin's HP48 Pong
+    {"720377ba05fd85ca140ef457189eb10d2eb2612c", QuirkProfile::VIP},    // quirks.ch8, checked against VIP
+    {"f1cfcffe1937ed6dd6eeed1a7f85dfc777bda700", QuirkProfile::MODERN}, // test_opcode.ch8
+};
+
+bool find_quirks(const uint8_t digest[SHA1_SIZE], QuirkProfile &profile)
+{
+    std::string hex = sha1_hex(digest);
+    for (const auto &rom : KNOWN_ROMS)
+    {
+        if (hex == rom.sha1)
+        {
+            profile = rom.profile;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_quirks(const std::string &name, QuirkProfile &profile)
+{
+    for (int i = 0; i < QUIRK_PROFILES; ++i)
+    {
+        if (name == NAMES[i])
+        {
+            profile = static_cast<QuirkProfile>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *quirks_name(QuirkProfile profile)
+{
+    return NAMES[static_cast<int>(profile)];
+}
@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <string>
+#include "Sha1.h"
+
+#ifndef QUIRKS_H
+#define QUIRKS_H
+
+// platforms whose CHIP-8 disagree on a few instructions. MODERN is what this
+// emulator has always done
+enum class QuirkProfile
+{
+    MODERN,
+    VIP,
+    CHIP48,
+    SCHIP
+};
+#define QUIRK_PROFILES 4
+
+// where Fx55/Fx65 leave I
+#define I_UNCHANGED 0
+#define I_PLUS_X 1
+#define I_PLUS_X_1 2
+
+struct Quirks
+{
+    // 8xy6/8xyE shift Vy into Vx instead of shifting Vx in place
+    bool shift_vy;
+    // Bnnn jumps to nnn + Vx, x being the top nibble of nnn, instead of nnn + V0
+    bool jump_vx;
+    // Fx1E sets VF when I goes past 0xFFF
+    bool add_i_carry;
+    // one of the I_ values
+    uint8_t load_store_i;
+};
+
+// indexed by QuirkProfile, constant so the core can be built once per profile
+constexpr Quirks QUIRKS[QUIRK_PROFILES] = {
+    {false, false, true, I_UNCHANGED}, // MODERN
+    {true, false, false, I_PLUS_X_1},  // VIP
+    {false, true, false, I_PLUS_X},    // CHIP48
+    {false, true, false, I_UNCHANGED}, // SCHIP
+};
+
+// the profile a known ROM was written for, looked up by the SHA-1 of its image
+bool find_quirks(const uint8_t digest[SHA1_SIZE], QuirkProfile &profile);
+// modern, vip, chip48 or schip
+bool parse_quirks(const std::string &name, QuirkProfile &profile);
+const char *quirks_name(QuirkProfile profile);
+
+#endif // QUIRKS_H
@@ -0,0 +1,73 @@
+#include "SDLAudio.h"
+#include <iostream>
+
+SDLAudio::SDLAudio(uint16_t buffer)
+{
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
+    {
+        std::cout << "failed to initialize SDL audio\n";
+        exit(1);
+    }
+    SDL_AudioSpec want = {};
+    want.freq = SAMPLE_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = buffer;
+    want.callback = callback;
+    want.userdata = this;
+    SDL_AudioSpec have;
+    device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+    if (device == 0)
+    {
+        std::cout << "failed to open audio device: " << SDL_GetError() << "\n";
+        exit(1);
+    }
+    SDL_PauseAudioDevice(device, 0);
+}
+
+SDLAudio::~SDLAudio()
+{
+    SDL_CloseAudioDevice(device);
+}
+
+// emulation thread, never blocks: a full ring drops the frame
+void SDLAudio::frame(bool on)
+{
+    frames.push(on);
+}
+
+void SDLAudio::callback(void *self, Uint8 *stream, int len)
+{
+    static_cast<SDLAudio *>(self)->fill(reinterpret_cast<int16_t *>(stream), len / sizeof(int16_t));
+}
+
+void SDLAudio::fill(int16_t *out, size_t count)
+{
+    while (count > 0)
+    {
+        if (left == 0)
+        {
+            uint8_t next;
+            while (frames.size() > AUDIO_MAX_LAG_FRAMES)
+            {
+                frames.pop(next);
+            }
+            // nothing queued, play silence for this buffer and look again
+            if (frames.pop(next))
+            {
+                on = next;
+                left = SAMPLES_PER_FRAME;
+            }
+            else
+            {
+                on = false;
+                left = count;
+            }
+        }
+        size_t n = left < count ? left : count;
+        wave.fill(out, n, on);
+        out += n;
+        count -= n;
+        left -= n;
+    }
+}
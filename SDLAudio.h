@@ -0,0 +1,35 @@
+#include <SDL2/SDL.h>
+#include "Audio.h"
+#include "SPSCRing.h"
+
+#ifndef SDL_AUDIO_H
+#define SDL_AUDIO_H
+
+#define AUDIO_QUEUE_SIZE 64
+// older frames are dropped once more than this are queued, so the sound
+// never drifts further behind the picture
+#define AUDIO_MAX_LAG_FRAMES 3
+
+// beeper driven from the SDL audio callback. the emulation thread only
+// pushes one byte per frame into a lock-free ring, the callback turns
+// queued frames into samples
+class SDLAudio : public Audio
+{
+private:
+    SDL_AudioDeviceID device = 0;
+    SPSCRing<uint8_t, AUDIO_QUEUE_SIZE> frames;
+    // owned by the callback thread
+    SquareWave wave;
+    bool on = false;
+    size_t left = 0;
+    static void callback(void *self, Uint8 *stream, int len);
+    void fill(int16_t *out, size_t count);
+
+public:
+    // buffer is the device buffer in samples, smaller means lower latency
+    SDLAudio(uint16_t buffer);
+    ~SDLAudio();
+    void frame(bool on) override;
+};
+
+#endif // SDL_AUDIO_H
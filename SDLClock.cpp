@@ -0,0 +1,22 @@
+#include "SDLClock.h"
+
+SDLClock::SDLClock() : start(SDL_GetPerformanceCounter()), frequency(SDL_GetPerformanceFrequency())
+{
+}
+
+uint64_t SDLClock::now()
+{
+    uint64_t counts = SDL_GetPerformanceCounter() - start;
+    return counts / frequency * 1000000 + counts % frequency * 1000000 / frequency;
+}
+
+// SDL_Delay only has millisecond resolution, sleep for the whole
+// milliseconds and let the scheduler's deadlines absorb the rest
+void SDLClock::sleep_until(uint64_t time)
+{
+    uint64_t t = now();
+    if (time > t + 1000)
+    {
+        SDL_Delay((time - t) / 1000);
+    }
+}
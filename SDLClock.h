@@ -0,0 +1,19 @@
+#include <SDL2/SDL.h>
+#include "Clock.h"
+
+#ifndef SDL_CLOCK_H
+#define SDL_CLOCK_H
+
+class SDLClock : public Clock
+{
+private:
+    uint64_t start;
+    uint64_t frequency;
+
+public:
+    SDLClock();
+    uint64_t now() override;
+    void sleep_until(uint64_t time) override;
+};
+
+#endif // SDL_CLOCK_H
@@ -0,0 +1,86 @@
+#include "SDLDisplay.h"
+
+static const uint32_t PALETTE[4] = {PIXEL_OFF, PIXEL_ON, PIXEL_PLANE2, PIXEL_BOTH};
+
+SDLDisplay::SDLDisplay()
+    : window(nullptr, SDL_DestroyWindow), renderer(nullptr, SDL_DestroyRenderer), texture(nullptr, SDL_DestroyTexture)
+{
+    SDLDisplay::init_SDL();
+}
+
+void SDLDisplay::draw(const Framebuffer &fb)
+{
+    if (presented && fb.equals(shown))
+    {
+        return;
+    }
+    void *pixels;
+    int pitch;
+    SDL_Rect area = {0, 0, fb.width(), fb.height()};
+    if (SDL_LockTexture(texture.get(), &area, &pixels, &pitch) < 0)
+    {
+        std::cout << "failed to lock texture: " << SDL_GetError() << "\n";
+        exit(1);
+    }
+    fb.expand(static_cast<uint32_t *>(pixels), pitch, PALETTE);
+    SDL_UnlockTexture(texture.get());
+    SDL_RenderCopy(renderer.get(), texture.get(), &area, nullptr);
+    SDL_RenderPresent(renderer.get());
+    shown = fb;
+    presented = true;
+}
+
+// the texture still holds the shown frame, so it only goes to the window again
+void SDLDisplay::repaint()
+{
+    if (!presented)
+    {
+        return;
+    }
+    SDL_Rect area = {0, 0, shown.width(), shown.height()};
+    SDL_RenderCopy(renderer.get(), texture.get(), &area, nullptr);
+    SDL_RenderPresent(renderer.get());
+}
+
+void SDLDisplay::init_SDL()
+{
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    {
+        std::cout << "failed to initialize SDL\n";
+        exit(1);
+    }
+    window.reset(SDL_CreateWindow(
+        "RICK-8",
+        SDL_WINDOWPOS_CENTERED,
+        SDL_WINDOWPOS_CENTERED,
+        COLS * PIXEL_SCALE,
+        ROWS * PIXEL_SCALE,
+        0));
+
+    if (window.get() == nullptr)
+    {
+        std::cout << "failed to create window\n";
+        exit(1);
+    }
+    renderer.reset(SDL_CreateRenderer(window.get(), -1, SDL_RENDERER_ACCELERATED));
+
+    if (renderer.get() == nullptr)
+    {
+        std::cout << "failed to create renderer\n";
+        exit(1);
+    }
+    texture.reset(SDL_CreateTexture(renderer.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, HIRES_COLS, HIRES_ROWS));
+
+    if (texture.get() == nullptr)
+    {
+        std::cout << "failed to create texture\n";
+        exit(1);
+    }
+}
+
+void SDLDisplay::destroy_window() {
+    texture.reset();
+    renderer.reset();
+    window.reset();
+    SDL_Quit();
+}
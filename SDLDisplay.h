@@ -0,0 +1,29 @@
+#include <memory>
+#include <SDL2/SDL.h>
+#include "Display.h"
+
+#ifndef SDL_DISPLAY_H
+#define SDL_DISPLAY_H
+
+class SDLDisplay : public Display
+{
+private:
+    std::unique_ptr<SDL_Window, decltype(&SDL_DestroyWindow)> window;
+    std::unique_ptr<SDL_Renderer, decltype(&SDL_DestroyRenderer)> renderer;
+    // HIRES_COLS x HIRES_ROWS streaming texture, low-res uses its top-left
+    // corner and the renderer scales either up to the window
+    std::unique_ptr<SDL_Texture, decltype(&SDL_DestroyTexture)> texture;
+    // what is currently on screen, to skip presenting an unchanged frame
+    Framebuffer shown;
+    bool presented = false;
+
+public:
+    SDLDisplay();
+    void draw(const Framebuffer &fb) override;
+    // presents the shown frame again after the window lost its contents
+    void repaint();
+    void init_SDL();
+    void destroy_window() override;
+};
+
+#endif // SDL_DISPLAY_H
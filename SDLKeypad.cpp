@@ -0,0 +1,107 @@
+#include "SDLKeypad.h"
+
+// applies the event in e, returns the key that went down or newKey
+uint8_t SDLKeypad::handleEvent(uint8_t newKey) {
+    if(e.type == SDL_WINDOWEVENT) {
+        exposed = exposed || e.window.event == SDL_WINDOWEVENT_EXPOSED || e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED;
+        return newKey;
+    }
+    if(e.type != SDL_KEYDOWN && e.type != SDL_KEYUP) {
+        return newKey;
+    }
+    bool up = e.type == SDL_KEYUP;
+    uint8_t key = NO_KEY;
+    switch(e.key.keysym.sym) {
+        case SDLK_1:
+            key = toggle(0x1, up);
+            break;
+        case SDLK_2:
+            key = toggle(0x2, up);
+            break;
+        case SDLK_3:
+            key = toggle(0x3, up);
+            break;
+        case SDLK_4:
+            key = toggle(0xC, up);
+            break;
+        case SDLK_q:
+            key = toggle(0x4, up);
+            break;
+        case SDLK_w:
+            key = toggle(0x5, up);
+            break;
+        case SDLK_e:
+            key = toggle(0x6, up);
+            break;
+        case SDLK_r:
+            key = toggle(0xD, up);
+            break;
+        case SDLK_a:
+            key = toggle(0x7, up);
+            break;
+        case SDLK_s:
+            key = toggle(0x8, up);
+            break;
+        case SDLK_d:
+            key = toggle(0x9, up);
+            break;
+        case SDLK_f:
+            key = toggle(0xE, up);
+            break;
+        case SDLK_z:
+            key = toggle(0xA, up);
+            break;
+        case SDLK_x:
+            key = toggle(0x0, up);
+            break;
+        case SDLK_c:
+            key = toggle(0xB, up);
+            break;
+        case SDLK_v:
+            key = toggle(0xF, up);
+            break;
+        case SDLK_TAB:
+            turbo = turbo || (!up && !e.key.repeat);
+            break;
+    }
+    // releases and held-key repeats update the keys but aren't presses
+    if(key == NO_KEY || up || e.key.repeat) {
+        return newKey;
+    }
+    return key;
+}
+
+bool SDLKeypad::turboPressed() {
+    bool pressed = turbo;
+    turbo = false;
+    return pressed;
+}
+
+bool SDLKeypad::windowExposed() {
+    bool was = exposed;
+    exposed = false;
+    return was;
+}
+
+uint8_t SDLKeypad::handleEvents() {
+    uint8_t newKey = NO_KEY;
+    while(SDL_PollEvent(&e) != 0) {
+        if(e.type == SDL_QUIT) {
+            return QUIT_KEY;
+        }
+        newKey = handleEvent(newKey);
+    }
+    return newKey;
+}
+
+uint8_t SDLKeypad::waitEvents(uint32_t timeout) {
+    if(SDL_WaitEventTimeout(&e, timeout) == 0) {
+        return NO_KEY;
+    }
+    if(e.type == SDL_QUIT) {
+        return QUIT_KEY;
+    }
+    uint8_t first = handleEvent(NO_KEY);
+    uint8_t rest = handleEvents();
+    return rest != NO_KEY ? rest : first;
+}
@@ -0,0 +1,23 @@
+#include <SDL2/SDL_events.h>
+#include "Keypad.h"
+#ifndef SDL_KEYPAD_H
+#define SDL_KEYPAD_H
+
+class SDLKeypad : public Keypad {
+    private:
+    SDL_Event e;
+    // Tab went down since the last turboPressed()
+    bool turbo = false;
+    // the window was exposed or resized since the last windowExposed()
+    bool exposed = false;
+    uint8_t handleEvent(uint8_t newKey);
+    public:
+    // the fast-forward hotkey, reported once per press
+    bool turboPressed();
+    // the window needs repainting, reported once per event
+    bool windowExposed();
+    uint8_t handleEvents() override;
+    uint8_t waitEvents(uint32_t timeout) override;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include <stddef.h>
+#include <atomic>
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+// lock-free ring for exactly one producer thread and one consumer thread.
+// N must be a power of two.
+template <typename T, size_t N>
+class SPSCRing
+{
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+
+private:
+    T items[N];
+    alignas(64) std::atomic<size_t> head{0}; // next slot to read
+    alignas(64) std::atomic<size_t> tail{0}; // next slot to write
+
+public:
+    bool push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+        {
+            return false;
+        }
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = items[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // pops up to max items in one go, returns how many
+    size_t pop_bulk(T *out, size_t max)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t available = tail.load(std::memory_order_acquire) - h;
+        size_t count = available < max ? available : max;
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = items[(h + i) & (N - 1)];
+        }
+        head.store(h + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t size()
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+};
+
+#endif // SPSC_RING_H
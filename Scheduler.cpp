@@ -0,0 +1,93 @@
+#include "Scheduler.h"
+
+Scheduler::Scheduler(CHIP8 &c, Clock &clk)
+    : chip8(c), clock(clk)
+{
+    start = clock.now();
+}
+
+uint64_t Scheduler::deadline(uint64_t f)
+{
+    return start + f * 1000000 / (FRAME_RATE * pace);
+}
+
+void Scheduler::run_frames(uint64_t frames)
+{
+    for (uint64_t i = 0; i < frames; ++i)
+    {
+        bool ff = fast.load(std::memory_order_relaxed);
+        uint32_t rate = ff ? turbo : 1;
+        if (rate != pace)
+        {
+            // count deadlines from now at the new rate, so nothing is owed
+            pace = rate;
+            start = clock.now();
+            frame = 0;
+        }
+        bool present = !ff || ++skipped % skip == 0;
+        if (stub != nullptr && !stub->poll())
+        {
+            stop();
+            return;
+        }
+        chip8.run_frame(present);
+        ++frame;
+        if (pace == 0)
+        {
+            continue;
+        }
+        uint64_t t = clock.now();
+        if (t > deadline(frame + MAX_LAG_FRAMES))
+        {
+            // fell too far behind (host stalled), drop the missed frames
+            start = t;
+            frame = 0;
+            continue;
+        }
+        // a machine waiting on Fx0A blocks on input for the rest of the frame
+        if (chip8.waiting_for_key() && deadline(frame) > t)
+        {
+            chip8.wait_input((deadline(frame) - t) / 1000);
+        }
+        clock.sleep_until(deadline(frame));
+    }
+}
+
+void Scheduler::run()
+{
+    while (!stopped.load(std::memory_order_relaxed))
+    {
+        run_frames(1);
+    }
+}
+
+void Scheduler::stop()
+{
+    stopped.store(true, std::memory_order_relaxed);
+}
+
+bool Scheduler::running()
+{
+    return !stopped.load(std::memory_order_relaxed);
+}
+
+void Scheduler::set_stub(GdbStub *s)
+{
+    stub = s;
+}
+
+void Scheduler::set_turbo(uint32_t multiple, uint32_t skip_frames)
+{
+    turbo = multiple;
+    skip = skip_frames > 0 ? skip_frames : 1;
+}
+
+void Scheduler::fast_forward(bool on)
+{
+    fast.store(on, std::memory_order_relaxed);
+}
+
+bool Scheduler::fast_forwarding()
+{
+    return fast.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,56 @@
+#include <stdint.h>
+#include <atomic>
+#include "CHIP8.h"
+#include "Clock.h"
+#include "GdbStub.h"
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// how far behind the schedule can fall before it stops trying to catch up
+#define MAX_LAG_FRAMES 5
+// fast-forward defaults: as fast as the host goes, presenting every 4th frame
+#define TURBO_SPEED 0
+#define TURBO_SKIP 4
+
+// runs the machine in 60 Hz frames, sleeping away whatever is left of each
+// frame. deadlines come from the frame count so rounding never accumulates.
+class Scheduler
+{
+private:
+    CHIP8 &chip8;
+    Clock &clock;
+    uint64_t start = 0;
+    uint64_t frame = 0;
+    std::atomic<bool> stopped{false};
+    // fast-forward
+    std::atomic<bool> fast{false};
+    uint32_t turbo = TURBO_SPEED;
+    uint32_t skip = TURBO_SKIP;
+    // the rate deadlines are counted at, a multiple of real time, 0 unpaced
+    uint32_t pace = 1;
+    uint32_t skipped = 0;
+    // serves a debugger between frames, null when there is none
+    GdbStub *stub = nullptr;
+
+    uint64_t deadline(uint64_t f);
+
+public:
+    Scheduler(CHIP8 &c, Clock &clk);
+    void run_frames(uint64_t frames);
+    // runs until stop() is called, from any thread
+    void run();
+    void stop();
+    // false once stopped, by stop() or by the debugger killing the machine
+    bool running();
+    // the stub's client holds the machine between frames, set before run()
+    void set_stub(GdbStub *s);
+    // fast-forward runs at multiple times real time, 0 for unpaced, and
+    // presents every skip-th frame. set before run()
+    void set_turbo(uint32_t multiple, uint32_t skip_frames);
+    // from any thread, switching back lands on real time without catching up
+    void fast_forward(bool on);
+    bool fast_forwarding();
+};
+
+#endif // SCHEDULER_H
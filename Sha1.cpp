@@ -0,0 +1,99 @@
+#include "Sha1.h"
+#include <cstdio>
+#include <cstring>
+
+static uint32_t rotl(uint32_t value, int bits)
+{
+    return value << bits | value >> (32 - bits);
+}
+
+static void sha1_block(uint32_t h[5], const uint8_t block[64])
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i)
+    {
+        w[i] = block[4 * i] << 24 | block[4 * i + 1] << 16 | block[4 * i + 2] << 8 | block[4 * i + 3];
+    }
+    for (int i = 16; i < 80; ++i)
+    {
+        w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; ++i)
+    {
+        uint32_t f, k;
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotl(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+void sha1(const uint8_t *data, size_t length, uint8_t digest[SHA1_SIZE])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t full = length / 64 * 64;
+    for (size_t i = 0; i < full; i += 64)
+    {
+        sha1_block(h, data + i);
+    }
+    // the tail, a 1 bit, zeros and the length in bits, in one or two blocks
+    uint8_t tail[128] = {0};
+    size_t rest = length - full;
+    std::memcpy(tail, data + full, rest);
+    tail[rest] = 0x80;
+    size_t blocks = rest < 56 ? 1 : 2;
+    uint64_t bits = static_cast<uint64_t>(length) * 8;
+    for (int i = 0; i < 8; ++i)
+    {
+        tail[blocks * 64 - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        sha1_block(h, tail + 64 * i);
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        digest[4 * i] = h[i] >> 24;
+        digest[4 * i + 1] = h[i] >> 16;
+        digest[4 * i + 2] = h[i] >> 8;
+        digest[4 * i + 3] = h[i];
+    }
+}
+
+std::string sha1_hex(const uint8_t digest[SHA1_SIZE])
+{
+    char hex[2 * SHA1_SIZE + 1];
+    for (int i = 0; i < SHA1_SIZE; ++i)
+    {
+        snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+    }
+    return hex;
+}
@@ -0,0 +1,15 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#ifndef SHA1_H
+#define SHA1_H
+
+#define SHA1_SIZE 20
+
+// FIPS 180-4 SHA-1, for identifying ROMs, not for security
+void sha1(const uint8_t *data, size_t length, uint8_t digest[SHA1_SIZE]);
+// lower-case hex, 40 characters
+std::string sha1_hex(const uint8_t digest[SHA1_SIZE]);
+
+#endif // SHA1_H
@@ -0,0 +1,262 @@
+#include "CHIP8.h"
+#include "Profile.h"
+
+#ifdef THREADED_DISPATCH
+
+// label index for a decoded op, kept in Op::label so dispatch is one load
+// from the decoded cache and one indirect jump at the end of each handler
+enum ThreadIndex : uint8_t
+{
+    T_HANDLER, T_SYS, T_CLS, T_RET, T_JP, T_CALL, T_SE, T_SNE, T_SER, T_LD, T_ADD,
+    T_LDR, T_OR, T_AND, T_XOR, T_ADDC, T_SUB, T_SHR, T_SUBN, T_SHL, T_SNER,
+    T_LDI, T_JPP, T_RND, T_DRW, T_SKP, T_SKNP, T_LDT, T_LDK, T_LDDT, T_LDST,
+    T_ADDI, T_LDF, T_LDB, T_RTM, T_MTR,
+    // the superinstructions fuse() makes
+    T_LD_LD, T_LD_ADD, T_ADD_LD, T_ADD_ADD, T_SE_JP, T_SNE_JP, T_LDI_DRW,
+    T_ADDI_DRW, T_ADDI_ADDI, T_ADDI_RTM, T_ADDI_MTR
+};
+
+// traps and anything outside plain CHIP-8 run their handler, which already
+// knows how to retire them
+uint8_t CHIP8::thread_label(const Op &op)
+{
+    static const uint8_t alu[16] = {T_LDR, T_OR, T_AND, T_XOR, T_ADDC, T_SUB, T_SHR, T_SUBN,
+                                    T_HANDLER, T_HANDLER, T_HANDLER, T_HANDLER, T_HANDLER, T_HANDLER, T_SHL, T_HANDLER};
+    static const uint8_t simple[16] = {T_SYS, T_JP, T_CALL, T_SE, T_SNE, T_SER, T_LD, T_ADD,
+                                       T_HANDLER, T_SNER, T_LDI, T_JPP, T_RND, T_DRW, T_HANDLER, T_HANDLER};
+    uint16_t instruction = op.instruction;
+    uint8_t kk = instruction & 0xFF;
+    if (op.count == 0 || variant != Variant::CHIP8)
+    {
+        return T_HANDLER;
+    }
+    if (op.count == 2)
+    {
+        uint8_t first = instruction >> 12;
+        uint8_t second = op.next >> 12;
+        if (first == 0x6 || first == 0x7)
+        {
+            return T_LD_LD + (first - 0x6) * 2 + second - 0x6;
+        }
+        if (first == 0x3 || first == 0x4)
+        {
+            return first == 0x3 ? T_SE_JP : T_SNE_JP;
+        }
+        if (first == 0xA)
+        {
+            return T_LDI_DRW;
+        }
+        // the rest start with Fx1E
+        if (second == 0xD)
+        {
+            return T_ADDI_DRW;
+        }
+        switch (op.next & 0xFF)
+        {
+        case 0x1E: return T_ADDI_ADDI;
+        case 0x55: return T_ADDI_RTM;
+        case 0x65: return T_ADDI_MTR;
+        }
+        return T_HANDLER;
+    }
+    switch (instruction >> 12)
+    {
+    case 0x0:
+        if ((instruction & 0x0FFF) == 0x0E0)
+            return T_CLS;
+        if ((instruction & 0x0FFF) == 0x0EE)
+            return T_RET;
+        return T_SYS;
+    case 0x5:
+    case 0x9:
+        return (instruction & 0xF) == 0 ? simple[instruction >> 12] : T_HANDLER;
+    case 0x8:
+        return alu[instruction & 0xF];
+    case 0xE:
+        return kk == 0x9E ? T_SKP : kk == 0xA1 ? T_SKNP : T_HANDLER;
+    case 0xF:
+        switch (kk)
+        {
+        case 0x07: return T_LDT;
+        case 0x0A: return T_LDK;
+        case 0x15: return T_LDDT;
+        case 0x18: return T_LDST;
+        case 0x1E: return T_ADDI;
+        case 0x29: return T_LDF;
+        case 0x33: return T_LDB;
+        case 0x55: return T_RTM;
+        case 0x65: return T_MTR;
+        }
+        return T_HANDLER;
+    default:
+        return simple[instruction >> 12];
+    }
+}
+
+#define X (op->x)
+#define Y (op->y)
+#define N (op->n)
+#define KK (op->kk)
+#define ADDR (op->nnn)
+// the second word of a superinstruction
+#define NX (op->next >> 8 & 0xF)
+#define NY (op->next >> 4 & 0xF)
+#define NN (op->next & 0xF)
+#define NKK (op->next & 0xFF)
+#define DISPATCH()                                                                        \
+    if (done >= instructions)                                                             \
+        return done;                                                                      \
+    op = &OPS[PC & (RAM_SIZE - 1)];                                                       \
+    if (op->handler == nullptr)                                                           \
+        decode_at(*op, PC);                                                               \
+    PROFILE(hit(PC & (RAM_SIZE - 1), op->instruction));                                   \
+    PC += 2;                                                                              \
+    goto *labels[op->label]
+#define NEXT() \
+    ++done;    \
+    DISPATCH()
+// a superinstruction only runs whole if both halves fit in the budget
+#define PAIR()                     \
+    if (instructions - done < 2)   \
+        goto op_SPLIT
+#define FUSED()                                                       \
+    PROFILE(hit((op - OPS + 2) & (RAM_SIZE - 1), op->next));          \
+    done += 2;                                                        \
+    fused += 2;                                                       \
+    DISPATCH()
+
+uint64_t CHIP8::run_threaded(uint64_t instructions)
+{
+    switch (quirk)
+    {
+    case QuirkProfile::VIP:
+        return run_threaded_as<QuirkProfile::VIP>(instructions);
+    case QuirkProfile::CHIP48:
+        return run_threaded_as<QuirkProfile::CHIP48>(instructions);
+    case QuirkProfile::SCHIP:
+        return run_threaded_as<QuirkProfile::SCHIP>(instructions);
+    default:
+        return run_threaded_as<QuirkProfile::MODERN>(instructions);
+    }
+}
+
+// one copy of the loop per quirk profile, so none of them tests a quirk
+template <QuirkProfile P>
+uint64_t CHIP8::run_threaded_as(uint64_t instructions)
+{
+    // same order as ThreadIndex
+    static void *const labels[] = {
+        &&op_HANDLER, &&op_SYS, &&op_CLS, &&op_RET, &&op_JP, &&op_CALL, &&op_SE, &&op_SNE, &&op_SER, &&op_LD, &&op_ADD,
+        &&op_LDR, &&op_OR, &&op_AND, &&op_XOR, &&op_ADDC, &&op_SUB, &&op_SHR, &&op_SUBN, &&op_SHL, &&op_SNER,
+        &&op_LDI, &&op_JPP, &&op_RND, &&op_DRW, &&op_SKP, &&op_SKNP, &&op_LDT, &&op_LDK, &&op_LDDT, &&op_LDST,
+        &&op_ADDI, &&op_LDF, &&op_LDB, &&op_RTM, &&op_MTR,
+        &&op_LD_LD, &&op_LD_ADD, &&op_ADD_LD, &&op_ADD_ADD, &&op_SE_JP, &&op_SNE_JP, &&op_LDI_DRW,
+        &&op_ADDI_DRW, &&op_ADDI_ADDI, &&op_ADDI_RTM, &&op_ADDI_MTR};
+    uint64_t done = 0;
+    Op *op;
+    DISPATCH();
+
+op_SYS:  NEXT();
+op_CLS:  CLS(); NEXT();
+op_RET:  RET(); NEXT();
+op_JP:   JP(ADDR); NEXT();
+op_CALL: CALL(ADDR); NEXT();
+// only plain CHIP-8 runs here, so a skip is always one word
+op_SE:   if (V[X] == KK) PC += 2; NEXT();
+op_SNE:  if (V[X] != KK) PC += 2; NEXT();
+op_SER:  if (V[X] == V[Y]) PC += 2; NEXT();
+op_LD:   LD(X, KK); NEXT();
+op_ADD:  ADD(X, KK); NEXT();
+op_LDR:  LDR(X, Y); NEXT();
+op_OR:   OR(X, Y); NEXT();
+op_AND:  AND(X, Y); NEXT();
+op_XOR:  XOR(X, Y); NEXT();
+op_ADDC: ADDC(X, Y); NEXT();
+op_SUB:  SUB(X, Y); NEXT();
+op_SHR:  SHR<P>(X, Y); NEXT();
+op_SUBN: SUBN(X, Y); NEXT();
+op_SHL:  SHL<P>(X, Y); NEXT();
+op_SNER: if (V[X] != V[Y]) PC += 2; NEXT();
+op_LDI:  LDI(ADDR); NEXT();
+op_JPP:  JPP<P>(ADDR); NEXT();
+op_RND:  RND(X, KK); NEXT();
+op_DRW:  DRW(X, Y, N); NEXT();
+op_SKP:  SKP(X); NEXT();
+op_SKNP: SKNP(X); NEXT();
+op_LDT:  LDT(X); NEXT();
+op_LDK:  LDK(X); NEXT();
+op_LDDT: LDDT(X); NEXT();
+op_LDST: LDST(X); NEXT();
+op_ADDI: ADDI<P>(X); NEXT();
+op_LDF:  LDF(X); NEXT();
+op_LDB:  LDB(X); NEXT();
+op_RTM:  RTM<P>(X); NEXT();
+op_MTR:  MTR<P>(X); NEXT();
+op_LD_LD:     PAIR(); LD(X, KK); LD(NX, NKK); PC += 2; FUSED();
+op_LD_ADD:    PAIR(); LD(X, KK); ADD(NX, NKK); PC += 2; FUSED();
+op_ADD_LD:    PAIR(); ADD(X, KK); LD(NX, NKK); PC += 2; FUSED();
+op_ADD_ADD:   PAIR(); ADD(X, KK); ADD(NX, NKK); PC += 2; FUSED();
+op_LDI_DRW:   PAIR(); LDI(ADDR); PC += 2; DRW(NX, NY, NN); FUSED();
+op_ADDI_DRW:  PAIR(); ADDI<P>(X); PC += 2; DRW(NX, NY, NN); FUSED();
+op_ADDI_ADDI: PAIR(); ADDI<P>(X); PC += 2; ADDI<P>(NX); FUSED();
+op_ADDI_RTM:  PAIR(); ADDI<P>(X); PC += 2; RTM<P>(NX); FUSED();
+op_ADDI_MTR:  PAIR(); ADDI<P>(X); PC += 2; MTR<P>(NX); FUSED();
+    // a skipped jump retires only the skip, and a delay loop closes on a
+    // jump that went round, so that is where one gets noticed
+op_SE_JP:
+    PAIR();
+    if (V[X] == KK)
+    {
+        PC += 2;
+        NEXT();
+    }
+    JP(op->next & NNN);
+    done += skip_idle(instructions - done - 2);
+    FUSED();
+op_SNE_JP:
+    PAIR();
+    if (V[X] != KK)
+    {
+        PC += 2;
+        NEXT();
+    }
+    JP(op->next & NNN);
+    FUSED();
+    // a superinstruction that would run past the budget only runs its first half
+op_SPLIT:
+    {
+        Op first = decode(op->instruction);
+        first.handler(*this, first);
+    }
+    NEXT();
+    // traps, and what the labels don't cover, retire what run_engine would have
+op_HANDLER:
+    if (op->count == 1)
+    {
+        op->handler(*this, *op);
+        NEXT();
+    }
+    if (op->count > instructions - done)
+    {
+        goto op_SPLIT;
+    }
+    op->handler(*this, *op);
+    // a breakpoint retires nothing and leaves the machine in front of it
+    if (retired == 0)
+    {
+        return done;
+    }
+    done += retired;
+    if (retired > 1)
+    {
+        PROFILE(hit((op - OPS + 2) & (RAM_SIZE - 1), op->next));
+        fused += retired;
+        if ((op->instruction >> 12) == 0x3)
+        {
+            done += skip_idle(instructions - done);
+        }
+    }
+    DISPATCH();
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "Trace.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// the core exits straight from error paths, which is exactly when the end
+// of the trace matters, so the open trace is also flushed at exit
+static Trace *open_trace = nullptr;
+
+static void close_open_trace()
+{
+    if (open_trace != nullptr)
+    {
+        open_trace->close();
+    }
+}
+
+Trace::Trace(const char *filename)
+{
+    out = fopen(filename, "wb");
+    if (out == nullptr)
+    {
+        std::cout << "cannot open trace file\n";
+        exit(1);
+    }
+    TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord), 0};
+    fwrite(&header, sizeof(header), 1, out);
+    writer = std::thread(&Trace::write_loop, this);
+    static bool registered = false;
+    if (!registered)
+    {
+        atexit(close_open_trace);
+        registered = true;
+    }
+    open_trace = this;
+}
+
+Trace::~Trace()
+{
+    close();
+}
+
+void Trace::close()
+{
+    if (out == nullptr)
+    {
+        return;
+    }
+    running = false;
+    writer.join();
+    drain();
+    fclose(out);
+    out = nullptr;
+    if (open_trace == this)
+    {
+        open_trace = nullptr;
+    }
+}
+
+void Trace::drain()
+{
+    TraceRecord batch[TRACE_BATCH];
+    size_t count;
+    while ((count = ring.pop_bulk(batch, TRACE_BATCH)) > 0)
+    {
+        fwrite(batch, sizeof(TraceRecord), count, out);
+    }
+}
+
+void Trace::write_loop()
+{
+    while (running)
+    {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
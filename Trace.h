@@ -0,0 +1,64 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include "SPSCRing.h"
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_MAGIC 0x54384B52 // "RK8T"
+#define TRACE_VERSION 2
+#define TRACE_RING_SIZE (1 << 16)
+#define TRACE_BATCH 4096
+
+// one executed instruction and the registers as it left them. bit n of
+// changed is set if it wrote a new value to Vn, VF and Fx65's loads included
+struct TraceRecord
+{
+    uint64_t cycle;
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t ic;
+    uint16_t changed;
+    uint8_t V[16];
+};
+static_assert(sizeof(TraceRecord) == 32, "trace records are written raw");
+
+struct TraceHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+// the emulation thread pushes records into a fixed ring and a writer thread
+// drains it to disk in batches. if the disk can't keep up the emulator waits
+// rather than dropping records.
+class Trace
+{
+private:
+    SPSCRing<TraceRecord, TRACE_RING_SIZE> ring;
+    FILE *out = nullptr;
+    std::atomic<bool> running{true};
+    std::thread writer;
+
+    void write_loop();
+    void drain();
+
+public:
+    Trace(const char *filename);
+    ~Trace();
+    // stops the writer and flushes everything recorded so far
+    void close();
+    void record(const TraceRecord &r)
+    {
+        while (!ring.push(r))
+        {
+            std::this_thread::yield();
+        }
+    }
+};
+
+#endif // TRACE_H
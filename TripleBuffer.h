@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <atomic>
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+// lock-free hand-off of the latest value from one writer thread to one
+// reader thread. the writer fills its own slot and swaps it into the
+// middle, the reader swaps the middle out when it holds something new.
+// neither side ever waits and the reader only ever sees whole values.
+template <typename T>
+class TripleBuffer
+{
+private:
+    // set on the middle index when it holds a value the reader hasn't taken
+    static constexpr uint8_t FRESH = 0x4;
+    T slots[3];
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t back = 0; // writer's slot
+    alignas(64) uint8_t front = 2; // reader's slot
+
+public:
+    // writer side
+    T &write_slot()
+    {
+        return slots[back];
+    }
+
+    void publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+    }
+
+    // reader side, true if read_slot() changed
+    bool update()
+    {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+        {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+        return true;
+    }
+
+    const T &read_slot() const
+    {
+        return slots[front];
+    }
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -0,0 +1,44 @@
+#include "Batch.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// runs one ROM on many machines at once and reports batch throughput
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        std::cout << "usage: batch rom lanes instructions [seed=N]\n";
+        exit(1);
+    }
+    long lanes = atol(argv[2]);
+    long instructions = atol(argv[3]);
+    if (lanes <= 0 || instructions <= 0)
+    {
+        std::cout << "lanes or instructions is not a number or 0\n";
+        exit(1);
+    }
+    Batch batch(lanes);
+    batch.load_ROM(argv[1]);
+    for (int i = 4; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("seed=", 0) == 0)
+        {
+            // lane n gets seed + n, lane 0 matches headless with the same seed
+            uint64_t seed = strtoull(arg.c_str() + 5, nullptr, 0);
+            for (long lane = 0; lane < lanes; ++lane)
+            {
+                batch.seed(lane, seed + lane);
+            }
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    batch.run(instructions);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double total = static_cast<double>(lanes) * instructions;
+    std::cerr << lanes << " lanes x " << instructions << " instructions in " << elapsed.count() << "s ("
+              << total / elapsed.count() / 1e6 << " M machine-instructions/s, "
+              << 100.0 * batch.vector_steps / total << "% vectorised)\n";
+}
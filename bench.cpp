@@ -0,0 +1,430 @@
+#include "CHIP8.h"
+#include "Batch.h"
+#include "Clock.h"
+#include "Scheduler.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// times every engine on a set of workloads and compares the numbers with a
+// stored baseline. metrics ending in _ns are lower-is-better, _mips
+// higher-is-better. every timing is taken against a fixed integer loop run
+// alongside it, and the gate compares metrics relative to that loop, which
+// takes out a uniformly faster or slower host but not a noisy one.
+
+#define BENCH_REPEATS 15
+#define DISPATCH_INSTRUCTIONS 500000
+#define ROM_FRAMES 250
+#define ROM_IPF 2000
+#define BATCH_LANES 256
+#define BATCH_INSTRUCTIONS 5000
+#define LOAD_REPEATS 500
+#define DRAW_REPEATS 5000
+// about a millisecond
+#define CALIBRATION_ROUNDS 200000
+#define CALIBRATION_METRIC "calibration.loop_ns"
+
+typedef std::map<std::string, double> Results;
+
+static const char *ROMS[] = {"br8kout.ch8", "chip8-test-rom.ch8", "ibm.ch8", "pong.rom", "test_opcode.ch8"};
+
+static const struct
+{
+    const char *name;
+    Engine engine;
+} ENGINES[] = {
+    {"interpreter", Engine::INTERPRETER},
+    {"threaded", Engine::THREADED},
+    {"jit", Engine::JIT},
+};
+
+// renders like SDLDisplay minus the SDL calls: skip an unchanged frame,
+// otherwise expand it into a 32-bit pixel buffer
+class BufferDisplay : public Display
+{
+private:
+    std::vector<uint32_t> pixels = std::vector<uint32_t>(HIRES_ROWS * HIRES_COLS);
+    Framebuffer shown;
+    bool presented = false;
+
+public:
+    void draw(const Framebuffer &fb) override
+    {
+        if (presented && fb.equals(shown))
+        {
+            return;
+        }
+        static const uint32_t palette[4] = {0xFF000000, 0xFFFFFFFF, 0xFFFF8800, 0xFF888888};
+        fb.expand(pixels.data(), HIRES_COLS * sizeof(uint32_t), palette);
+        shown = fb;
+        presented = true;
+    }
+};
+
+static double time_once(const std::function<void()> &work)
+{
+    auto start = std::chrono::steady_clock::now();
+    work();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// xorshift steps with a table load and store, dependent on each other like
+// an interpreter's dispatch, no emulator code involved
+static void calibration_slice()
+{
+    static uint8_t table[RAM_SIZE];
+    static volatile uint64_t sink;
+    uint64_t x = 88172645463325252ULL;
+    for (int i = 0; i < CALIBRATION_ROUNDS; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        x += table[x & (RAM_SIZE - 1)]++;
+    }
+    sink = sink + x;
+}
+
+// the fastest calibration slice of the run, in seconds
+static double fastest_slice = 1e30;
+
+// best of BENCH_REPEATS, in calibration slices. a slice runs before each
+// repeat and the best of each is taken over the same stretch of time, so a
+// host that is slow for a while is slow for both and the ratio holds.
+// to_host_units turns the results back into time at the end.
+static double best_of(const std::function<void()> &work)
+{
+    double best = 1e30;
+    double slice = 1e30;
+    for (int i = 0; i < BENCH_REPEATS; ++i)
+    {
+        slice = std::min(slice, time_once(calibration_slice));
+        best = std::min(best, time_once(work));
+    }
+    fastest_slice = std::min(fastest_slice, slice);
+    return best / slice;
+}
+
+// slices to seconds at the fastest slice seen, and the slice itself as a
+// metric so a comparison can divide it back out
+static void to_host_units(Results &results)
+{
+    for (auto &r : results)
+    {
+        bool lower_is_better = r.first.size() > 3 && r.first.compare(r.first.size() - 3, 3, "_ns") == 0;
+        r.second = lower_is_better ? r.second * fastest_slice : r.second / fastest_slice;
+    }
+    results[CALIBRATION_METRIC] = fastest_slice * 1e9 / CALIBRATION_ROUNDS;
+}
+
+static std::unique_ptr<CHIP8> make_chip8(Engine engine, Variant variant = Variant::CHIP8)
+{
+    auto chip8 = std::make_unique<CHIP8>(false,
+                                         std::make_unique<NullDisplay>(),
+                                         std::make_unique<NullKeypad>());
+    chip8->set_variant(variant);
+    chip8->set_engine(engine);
+    chip8->seed(1);
+    return chip8;
+}
+
+static void put(std::vector<uint8_t> &rom, uint16_t instruction)
+{
+    rom.push_back(instruction >> 8);
+    rom.push_back(instruction & 0xFF);
+}
+
+// setup, then body repeated to fill the loop, then a jump back to the loop
+static std::vector<uint8_t> loop_program(std::vector<uint16_t> setup, std::vector<uint16_t> body)
+{
+    std::vector<uint8_t> rom;
+    for (uint16_t ins : setup)
+    {
+        put(rom, ins);
+    }
+    uint16_t loop = ROM_START + rom.size();
+    while (rom.size() < 0x400)
+    {
+        for (uint16_t ins : body)
+        {
+            put(rom, ins);
+        }
+    }
+    put(rom, 0x1000 | loop);
+    return rom;
+}
+
+// a chain of jumps, each to the next
+static std::vector<uint8_t> jump_program()
+{
+    std::vector<uint8_t> rom;
+    while (rom.size() < 0x400)
+    {
+        put(rom, 0x1000 | (ROM_START + rom.size() + 2));
+    }
+    put(rom, 0x1000 | ROM_START);
+    return rom;
+}
+
+static void bench_dispatch(Results &results)
+{
+    // data lives at 0xE00, well clear of the code
+    const struct
+    {
+        const char *name;
+        std::vector<uint8_t> rom;
+    } classes[] = {
+        {"load", loop_program({}, {0x6A12, 0x6B34})},
+        {"add", loop_program({}, {0x7A01, 0x7B03})},
+        {"alu", loop_program({0x6A05, 0x6B03}, {0x8AB4, 0x8AB5, 0x8AB1, 0x8AB2, 0x8AB3, 0x8A06, 0x8AB7, 0x8A0E})},
+        {"skip", loop_program({}, {0x3BFF, 0x3B00, 0x6A00})},
+        {"jump", jump_program()},
+        {"call", loop_program({0x1206, 0x00EE, 0x00EE}, {0x2202})},
+        {"index", loop_program({0x6A01}, {0xAE00, 0xFA1E})},
+        {"memory", loop_program({0xAE00}, {0xFA33, 0xF255, 0xF265})},
+        {"random", loop_program({}, {0xCAFF})},
+        {"draw", loop_program({0xA050}, {0xD015})},
+        {"clear", loop_program({}, {0x00E0})},
+    };
+    for (auto &c : classes)
+    {
+        for (auto &e : ENGINES)
+        {
+            auto chip8 = make_chip8(e.engine);
+            chip8->load_ROM(c.rom.data(), c.rom.size());
+            chip8->set_speed(ROM_IPF);
+            double seconds = best_of([&] { chip8->run(DISPATCH_INSTRUCTIONS); });
+            results[std::string("dispatch.") + c.name + "." + e.name + "_ns"] = seconds * 1e9 / DISPATCH_INSTRUCTIONS;
+        }
+    }
+}
+
+// hi-res two-plane screens on the interpreter, the only engine that runs them
+static void bench_xochip(Results &results)
+{
+    const struct
+    {
+        const char *name;
+        std::vector<uint8_t> rom;
+    } classes[] = {
+        {"scroll", loop_program({0x00FF, 0xF301}, {0x00C1, 0x00FB, 0x00D1, 0x00FC})},
+        {"sprite16", loop_program({0x00FF, 0xF301, 0xA050, 0x6107}, {0xD010, 0x7109})},
+    };
+    for (auto &c : classes)
+    {
+        auto chip8 = make_chip8(Engine::INTERPRETER, Variant::XOCHIP);
+        chip8->load_ROM(c.rom.data(), c.rom.size());
+        chip8->set_speed(ROM_IPF);
+        double seconds = best_of([&] { chip8->run(DISPATCH_INSTRUCTIONS); });
+        results[std::string("xochip.") + c.name + ".interpreter_ns"] = seconds * 1e9 / DISPATCH_INSTRUCTIONS;
+    }
+}
+
+static void bench_display(Results &results)
+{
+    BufferDisplay display;
+    Display &base = display;
+    Framebuffer a;
+    Framebuffer b;
+    b.drawRow(0, 0, 0xFF);
+    // alternating frames always repaint, the same frame twice never does
+    double changed = best_of([&] {
+        for (int i = 0; i < DRAW_REPEATS; ++i)
+        {
+            base.draw(i & 1 ? a : b);
+        }
+    });
+    double unchanged = best_of([&] {
+        for (int i = 0; i < DRAW_REPEATS; ++i)
+        {
+            base.draw(a);
+        }
+    });
+    results["display.draw_changed_ns"] = changed * 1e9 / DRAW_REPEATS;
+    results["display.draw_unchanged_ns"] = unchanged * 1e9 / DRAW_REPEATS;
+}
+
+static void bench_roms(Results &results, const std::string &dir)
+{
+    for (const char *name : ROMS)
+    {
+        std::string path = dir + "/" + name;
+        std::string key = std::string("rom.") + name;
+        auto loader = make_chip8(Engine::JIT);
+        double load = best_of([&] {
+            for (int i = 0; i < LOAD_REPEATS; ++i)
+            {
+                loader->load_ROM(path.c_str());
+            }
+        });
+        results[key + ".load_ns"] = load * 1e9 / LOAD_REPEATS;
+        // whole frames through the scheduler, on a clock that never sleeps
+        for (auto &e : ENGINES)
+        {
+            auto chip8 = make_chip8(e.engine);
+            chip8->load_ROM(path.c_str());
+            chip8->set_speed(ROM_IPF);
+            VirtualClock clock;
+            Scheduler scheduler(*chip8, clock);
+            int runs = 0;
+            double seconds = best_of([&] {
+                scheduler.run_frames(ROM_FRAMES);
+                ++runs;
+            });
+            // idle-skipped instructions never ran, so they are a rate of their own
+            double idle = static_cast<double>(chip8->idle_count()) / runs;
+            double executed = static_cast<double>(chip8->cycle_count()) / runs - idle;
+            results[key + "." + e.name + "_mips"] = executed / seconds / 1e6;
+            results[key + "." + e.name + "_idle_mips"] = idle / seconds / 1e6;
+        }
+        Batch lanes(BATCH_LANES);
+        lanes.load_ROM(path.c_str());
+        double batch = best_of([&] { lanes.run(BATCH_INSTRUCTIONS); });
+        results[key + ".batch_mips"] = static_cast<double>(BATCH_LANES) * BATCH_INSTRUCTIONS / batch / 1e6;
+    }
+}
+
+static void write_json(std::ostream &out, const Results &results)
+{
+    out << "{\n";
+    size_t i = 0;
+    for (auto &r : results)
+    {
+        char value[32];
+        snprintf(value, sizeof(value), "%.3f", r.second);
+        out << "  \"" << r.first << "\": " << value << (++i < results.size() ? ",\n" : "\n");
+    }
+    out << "}\n";
+}
+
+// reads back the flat "name": number objects that write_json produces
+static Results read_json(const char *filename)
+{
+    std::ifstream in(filename);
+    if (!in.is_open())
+    {
+        std::cout << "cannot open baseline " << filename << "\n";
+        exit(1);
+    }
+    Results results;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t open = line.find('"');
+        size_t close = line.find('"', open + 1);
+        size_t colon = line.find(':', close);
+        if (open == std::string::npos || close == std::string::npos || colon == std::string::npos)
+        {
+            continue;
+        }
+        results[line.substr(open + 1, close - open - 1)] = atof(line.c_str() + colon + 1);
+    }
+    return results;
+}
+
+// prints every metric against the baseline, returns how many got worse by
+// more than tolerance percent. unless absolute is set, each run's numbers
+// are first put in units of its own calibration loop
+static int compare(const Results &results, const Results &baseline, double tolerance, bool absolute)
+{
+    double scale = 1;
+    auto run_loop = results.find(CALIBRATION_METRIC);
+    auto base_loop = baseline.find(CALIBRATION_METRIC);
+    if (!absolute && run_loop != results.end() && base_loop != baseline.end() && run_loop->second > 0)
+    {
+        scale = base_loop->second / run_loop->second;
+        fprintf(stderr, "host is %.2fx the baseline's speed on the calibration loop\n", scale);
+    }
+    else if (!absolute)
+    {
+        std::cerr << "baseline has no calibration loop, comparing absolute numbers\n";
+    }
+    int regressions = 0;
+    for (auto &r : results)
+    {
+        auto base = baseline.find(r.first);
+        if (base == baseline.end() || base->second <= 0 || r.first == CALIBRATION_METRIC)
+        {
+            continue;
+        }
+        bool lower_is_better = r.first.size() > 3 && r.first.compare(r.first.size() - 3, 3, "_ns") == 0;
+        // in the baseline host's time
+        double value = lower_is_better ? r.second * scale : r.second / scale;
+        double change = (value - base->second) / base->second * 100;
+        double worse = lower_is_better ? change : -change;
+        bool regressed = worse > tolerance;
+        regressions += regressed;
+        fprintf(stderr, "%-44s %12.3f %12.3f %+7.1f%%%s\n", r.first.c_str(), base->second, value, change,
+                regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = "roms";
+    std::string out;
+    std::string baseline;
+    double tolerance = 10;
+    bool absolute = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("roms=", 0) == 0)
+        {
+            dir = arg.substr(5);
+        }
+        else if (arg.rfind("out=", 0) == 0)
+        {
+            out = arg.substr(4);
+        }
+        else if (arg.rfind("baseline=", 0) == 0)
+        {
+            baseline = arg.substr(9);
+        }
+        else if (arg.rfind("tolerance=", 0) == 0)
+        {
+            tolerance = atof(arg.c_str() + 10);
+        }
+        else if (arg == "absolute")
+        {
+            absolute = true;
+        }
+        else
+        {
+            std::cout << "usage: bench [roms=DIR] [out=FILE] [baseline=FILE] [tolerance=PERCENT] [absolute]\n";
+            exit(1);
+        }
+    }
+    Results results;
+    bench_dispatch(results);
+    bench_xochip(results);
+    bench_display(results);
+    bench_roms(results, dir);
+    to_host_units(results);
+    if (out.empty())
+    {
+        write_json(std::cout, results);
+    }
+    else
+    {
+        std::ofstream file(out);
+        write_json(file, results);
+    }
+    if (!baseline.empty())
+    {
+        int regressions = compare(results, read_json(baseline.c_str()), tolerance, absolute);
+        if (regressions > 0)
+        {
+            std::cerr << regressions << " metrics regressed by more than " << tolerance << "%\n";
+            return 1;
+        }
+    }
+}
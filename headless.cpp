@@ -0,0 +1,224 @@
+#include "CHIP8.h"
+#include "Movie.h"
+#include "GdbStub.h"
+#include "Capture.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// runs a ROM with the null backends, no window and no frame pacing
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "usage: headless rom instructions [jit|threaded] [schip|xochip] [quirks=modern|vip|chip48|schip] [seed=N] [trace=FILE] [load=FILE] [save=FILE] [wav=FILE] [movie=FILE] [gdb=PORT|gdb=SOCKET] [video=FILE.y4m|FILE.png|FILE.rgb] [scale=N]\n";
+        exit(1);
+    }
+    long instructions = atol(argv[2]);
+    if (instructions <= 0)
+    {
+        std::cout << "instructions is not a number or 0\n";
+        exit(1);
+    }
+    // a movie brings its own input, seed, speed and instruction set, and
+    // replaces the instruction count with its frame count
+    Movie movie;
+    bool replay = false;
+    // a capture is sized for the variant before the machine exists
+    std::string video;
+    int scale = 1;
+    bool hires = false;
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("movie=", 0) == 0)
+        {
+            movie.load(argv[i] + 6);
+            replay = true;
+        }
+        else if (arg.rfind("video=", 0) == 0)
+        {
+            video = arg.substr(6);
+        }
+        else if (arg.rfind("scale=", 0) == 0)
+        {
+            scale = atoi(arg.c_str() + 6);
+            if (scale <= 0)
+            {
+                std::cout << "scale is not a number or 0\n";
+                exit(1);
+            }
+        }
+        else if (arg == "schip" || arg == "xochip")
+        {
+            hires = true;
+        }
+    }
+    if (replay)
+    {
+        hires = static_cast<Variant>(movie.variant) != Variant::CHIP8;
+    }
+    std::unique_ptr<Keypad> keypad;
+    if (replay)
+    {
+        keypad = std::make_unique<MovieKeypad>(movie);
+    }
+    else
+    {
+        keypad = std::make_unique<NullKeypad>();
+    }
+    std::unique_ptr<Display> display;
+    CaptureDisplay *capture = nullptr;
+    if (!video.empty())
+    {
+        auto sink = std::make_unique<CaptureDisplay>(video.c_str(), hires ? HIRES_COLS : COLS,
+                                                     hires ? HIRES_ROWS : ROWS, scale);
+        capture = sink.get();
+        display = std::move(sink);
+    }
+    else
+    {
+        display = std::make_unique<NullDisplay>();
+    }
+    auto chip8 = std::make_unique<CHIP8>(false, std::move(display), std::move(keypad));
+    // the default seed keeps headless runs reproducible
+    chip8->seed(replay ? movie.seed : 1);
+    if (replay)
+    {
+        chip8->set_variant(static_cast<Variant>(movie.variant));
+        chip8->set_quirks(static_cast<QuirkProfile>(movie.quirks));
+        chip8->set_speed(movie.ipf);
+    }
+    // the variant has to be set before the ROM goes in, and a state after
+    std::string load;
+    std::string save;
+    std::string gdb;
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "jit")
+        {
+            chip8->set_engine(Engine::JIT);
+        }
+        else if (arg == "threaded")
+        {
+            chip8->set_engine(Engine::THREADED);
+        }
+        else if (arg == "schip")
+        {
+            chip8->set_variant(Variant::SCHIP);
+        }
+        else if (arg == "xochip")
+        {
+            chip8->set_variant(Variant::XOCHIP);
+        }
+        else if (arg.rfind("quirks=", 0) == 0)
+        {
+            QuirkProfile profile;
+            if (!parse_quirks(arg.substr(7), profile))
+            {
+                std::cout << "quirks is one of modern, vip, chip48, schip\n";
+                exit(1);
+            }
+            chip8->set_quirks(profile);
+        }
+        else if (arg.rfind("seed=", 0) == 0)
+        {
+            chip8->seed(strtoull(arg.c_str() + 5, nullptr, 0));
+        }
+        else if (arg.rfind("trace=", 0) == 0)
+        {
+            chip8->start_trace(arg.c_str() + 6);
+        }
+        else if (arg.rfind("load=", 0) == 0)
+        {
+            load = arg.substr(5);
+        }
+        else if (arg.rfind("wav=", 0) == 0)
+        {
+            chip8->set_audio(std::make_unique<WavAudio>(arg.c_str() + 4));
+        }
+        else if (arg.rfind("save=", 0) == 0)
+        {
+            save = arg.substr(5);
+        }
+        else if (arg.rfind("gdb=", 0) == 0)
+        {
+            gdb = arg.substr(4);
+        }
+    }
+    chip8->load_ROM(argv[1]);
+    if (replay && std::memcmp(chip8->rom_digest(), movie.rom_sha1, SHA1_SIZE) != 0)
+    {
+        std::cout << "movie was recorded on rom " << sha1_hex(movie.rom_sha1) << "\n";
+        exit(1);
+    }
+    if (!load.empty())
+    {
+        chip8->load_state(load.c_str());
+    }
+    // a debugged or captured run goes frame by frame, so the client is served
+    // and a frame is drawn in between, and ends once the instructions are used up
+    std::unique_ptr<GdbStub> stub;
+    if (!gdb.empty())
+    {
+        stub = std::make_unique<GdbStub>(*chip8, gdb);
+    }
+    uint64_t idle_before = chip8->idle_count();
+    auto start = std::chrono::steady_clock::now();
+    uint64_t ran;
+    if (stub != nullptr || (capture != nullptr && !replay))
+    {
+        uint64_t before = chip8->cycle_count();
+        while (chip8->cycle_count() - before < static_cast<uint64_t>(instructions) && (stub == nullptr || stub->poll()))
+        {
+            chip8->run_frame();
+        }
+        ran = chip8->cycle_count() - before;
+        stub.reset();
+    }
+    else if (replay)
+    {
+        uint64_t before = chip8->cycle_count();
+        for (uint64_t frame = 0; frame < movie.frames; ++frame)
+        {
+            chip8->run_frame();
+        }
+        ran = chip8->cycle_count() - before;
+    }
+    else
+    {
+        ran = chip8->run(instructions);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (!save.empty())
+    {
+        chip8->save_state(save.c_str());
+    }
+    // instructions skipped while idle never ran, fused or not, so they are
+    // counted apart from the rate
+    uint64_t idle = chip8->idle_count() - idle_before;
+    uint64_t executed = ran - idle;
+    std::cerr << executed << " instructions in " << elapsed.count() << "s ("
+              << executed / elapsed.count() / 1e6 << " MIPS), " << idle << " more skipped while idle\n";
+    char fused[16];
+    // a stopped machine or an empty movie ran nothing
+    snprintf(fused, sizeof(fused), "%.1f%%", executed == 0 ? 0.0 : 100.0 * chip8->fused_count() / executed);
+    std::cerr << fused << " of them in superinstructions\n";
+    if (replay)
+    {
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(chip8->framebuffer().hash()));
+        std::cerr << movie.frames << " frames replayed, screen " << hash << "\n";
+    }
+    // flushes the trace and the capture, and prints the profile when one is
+    // built in
+    chip8->clean_up();
+    if (capture != nullptr)
+    {
+        std::cerr << capture->frame_count() << " frames captured, " << capture->frame_width() << "x"
+                  << capture->frame_height() << "\n";
+    }
+}
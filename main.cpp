@@ -1,47 +1,258 @@
 #include "CHIP8.h"
+#include "SDLDisplay.h"
+#include "SDLKeypad.h"
+#include "SDLClock.h"
+#include "SDLAudio.h"
+#include "Movie.h"
+#include "Scheduler.h"
+#include "GdbStub.h"
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+// how long the render thread waits for input before checking for a frame
+#define RENDER_WAIT_MS 2
+// audio device buffer in samples, about 6 ms
+#define AUDIO_BUFFER 256
+
 bool debug = false;
-long fps = 60;
-uint64_t tpf = 1000 / fps;
+Engine engine = Engine::INTERPRETER;
+Variant variant = Variant::CHIP8;
+// left to the ROM database unless given
+QuirkProfile quirks = QuirkProfile::MODERN;
+bool choose_quirks = false;
+long ipf = 10;
+uint64_t seed = 0;
+std::string trace;
+std::string state;
+std::string record;
+std::string play;
+std::string gdb;
+long audio_buffer = AUDIO_BUFFER;
+bool fast_forward = false;
+long turbo = TURBO_SPEED;
+long turbo_skip = TURBO_SKIP;
 
 void handleArguments(int argc, char **argv)
 {
     if (argc < 3)
     {
-        std::cout << "usage: emu rom fps\n";
+        std::cout << "usage: emu rom instructions_per_frame [d] [jit|threaded] [schip|xochip] [quirks=modern|vip|chip48|schip] [seed=N] [trace=FILE] [load=FILE] [audio=SAMPLES] [record=FILE|play=FILE] [ff] [turbo=N] [skip=K] [gdb=PORT|gdb=SOCKET]\n";
         exit(1);
     }
     debug = false;
-    if (argc == 4 && argv[3][0] == 'd')
+    for (int i = 3; i < argc; ++i)
     {
-        debug = true;
+        if (std::string(argv[i]) == "jit")
+        {
+            engine = Engine::JIT;
+        }
+        else if (std::string(argv[i]) == "threaded")
+        {
+            engine = Engine::THREADED;
+        }
+        else if (std::string(argv[i]) == "schip")
+        {
+            variant = Variant::SCHIP;
+        }
+        else if (std::string(argv[i]) == "xochip")
+        {
+            variant = Variant::XOCHIP;
+        }
+        else if (std::string(argv[i]).rfind("quirks=", 0) == 0)
+        {
+            if (!parse_quirks(argv[i] + 7, quirks))
+            {
+                std::cout << "quirks is one of modern, vip, chip48, schip\n";
+                exit(1);
+            }
+            choose_quirks = true;
+        }
+        else if (std::string(argv[i]).rfind("seed=", 0) == 0)
+        {
+            seed = strtoull(argv[i] + 5, nullptr, 0);
+        }
+        else if (std::string(argv[i]).rfind("trace=", 0) == 0)
+        {
+            trace = argv[i] + 6;
+        }
+        else if (std::string(argv[i]).rfind("load=", 0) == 0)
+        {
+            state = argv[i] + 5;
+        }
+        else if (std::string(argv[i]).rfind("record=", 0) == 0)
+        {
+            record = argv[i] + 7;
+        }
+        else if (std::string(argv[i]).rfind("play=", 0) == 0)
+        {
+            play = argv[i] + 5;
+        }
+        else if (std::string(argv[i]).rfind("gdb=", 0) == 0)
+        {
+            gdb = argv[i] + 4;
+        }
+        else if (std::string(argv[i]) == "ff")
+        {
+            fast_forward = true;
+        }
+        else if (std::string(argv[i]).rfind("turbo=", 0) == 0)
+        {
+            // times real time while fast-forwarding, 0 is as fast as possible
+            turbo = atol(argv[i] + 6);
+        }
+        else if (std::string(argv[i]).rfind("skip=", 0) == 0)
+        {
+            turbo_skip = atol(argv[i] + 5);
+        }
+        else if (std::string(argv[i]).rfind("audio=", 0) == 0)
+        {
+            // 0 turns sound off
+            audio_buffer = atol(argv[i] + 6);
+        }
+        else if (argv[i][0] == 'd')
+        {
+            debug = true;
+        }
     }
-    fps = atol(argv[2]);
-    if (fps == 0)
+    if (turbo < 0 || turbo_skip <= 0)
     {
-        std::cout << "fps is not a number or 0\n";
+        std::cout << "turbo must be 0 or more and skip at least 1\n";
         exit(1);
     }
-    tpf = 1000 / fps;
-    if (tpf <= 1)
+    ipf = atol(argv[2]);
+    if (ipf <= 0)
     {
-        std::cout << "fps is too high\n";
+        std::cout << "instructions per frame is not a number or 0\n";
         exit(1);
     }
 }
+// emulation runs on its own thread and publishes finished frames, this
+// thread owns the window and the input device and only renders
 int main(int argc, char **argv)
 {
     handleArguments(argc, argv);
-    auto chip8 = std::make_unique<CHIP8>(debug);
+    // a movie being played sets the run up the way it was recorded, one being
+    // recorded needs a seed it can write down
+    Movie movie;
+    if (!play.empty())
+    {
+        movie.load(play.c_str());
+        seed = movie.seed;
+        ipf = movie.ipf;
+        variant = static_cast<Variant>(movie.variant);
+        quirks = static_cast<QuirkProfile>(movie.quirks);
+        choose_quirks = true;
+    }
+    else if (!record.empty() && seed == 0)
+    {
+        std::random_device rd;
+        seed = static_cast<uint64_t>(rd()) << 32 | rd();
+    }
+    SDLDisplay display;
+    SDLKeypad keypad;
+    TripleBuffer<Framebuffer> frames;
+    KeyQueue input;
+    std::unique_ptr<Keypad> machine_keypad = std::make_unique<QueueKeypad>(input);
+    if (!play.empty())
+    {
+        machine_keypad = std::make_unique<MovieKeypad>(movie);
+    }
+    else if (!record.empty())
+    {
+        machine_keypad = std::make_unique<RecordKeypad>(std::move(machine_keypad), movie);
+    }
+    auto chip8 = std::make_unique<CHIP8>(debug,
+                                         std::make_unique<FrameDisplay>(frames),
+                                         std::move(machine_keypad));
+    chip8->set_variant(variant);
+    if (choose_quirks)
+    {
+        chip8->set_quirks(quirks);
+    }
+    chip8->set_engine(engine);
+    chip8->set_speed(ipf);
+    if (audio_buffer > 0)
+    {
+        chip8->set_audio(std::make_unique<SDLAudio>(audio_buffer));
+    }
+    if (seed != 0)
+    {
+        chip8->seed(seed);
+    }
+    if (!trace.empty())
+    {
+        chip8->start_trace(trace.c_str());
+    }
     chip8->load_ROM(argv[1]);
-    uint64_t t;
-    while (true)
+    if (!play.empty() && std::memcmp(chip8->rom_digest(), movie.rom_sha1, SHA1_SIZE) != 0)
     {
-        if (SDL_GetTicks() - t > tpf)
+        std::cout << "movie was recorded on rom " << sha1_hex(movie.rom_sha1) << "\n";
+        exit(1);
+    }
+    std::memcpy(movie.rom_sha1, chip8->rom_digest(), SHA1_SIZE);
+    movie.seed = seed;
+    movie.ipf = ipf;
+    movie.variant = static_cast<uint8_t>(variant);
+    movie.quirks = static_cast<uint8_t>(chip8->quirk_profile());
+    if (!state.empty())
+    {
+        chip8->load_state(state.c_str());
+    }
+    SDLClock clock;
+    Scheduler scheduler(*chip8, clock);
+    scheduler.set_turbo(turbo, turbo_skip);
+    scheduler.fast_forward(fast_forward);
+    std::unique_ptr<GdbStub> stub;
+    if (!gdb.empty())
+    {
+        stub = std::make_unique<GdbStub>(*chip8, gdb);
+        scheduler.set_stub(stub.get());
+    }
+    std::thread emulation([&] { scheduler.run(); });
+
+    uint16_t sent = 0;
+    while (scheduler.running())
+    {
+        uint8_t key = keypad.waitEvents(RENDER_WAIT_MS);
+        if (key == QUIT_KEY)
         {
-            t = SDL_GetTicks();
-            chip8->step();
+            break;
         }
+        // Tab flips between fast-forward and real time
+        if (keypad.turboPressed())
+        {
+            scheduler.fast_forward(!scheduler.fast_forwarding());
+        }
+        uint16_t held = keypad.heldKeys();
+        if ((key != NO_KEY || held != sent) && input.push({held, key}))
+        {
+            sent = held;
+        }
+        if (frames.update())
+        {
+            display.draw(frames.read_slot());
+        }
+        // an unchanged frame isn't presented, so a window that lost its
+        // contents gets the shown one again
+        if (keypad.windowExposed())
+        {
+            display.repaint();
+        }
+    }
+    scheduler.stop();
+    if (stub != nullptr)
+    {
+        stub->hang_up();
+    }
+    emulation.join();
+    chip8->clean_up();
+    display.destroy_window();
+    if (!record.empty())
+    {
+        movie.save(record.c_str());
     }
-}
\ No newline at end of file
+}
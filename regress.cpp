@@ -0,0 +1,309 @@
+#include "CHIP8.h"
+#include "Batch.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// runs every ROM in the golden file on every engine, hashing the screen at
+// fixed frames, and checks the hashes against the stored ones. jobs are
+// spread over all cores. a plain entry plays the ROM with the quirks the
+// ROM database picks, one named rom:profile with those quirks forced.
+
+#define REGRESS_FRAMES 600
+#define REGRESS_CHECKPOINT 60
+#define REGRESS_IPF 20
+#define REGRESS_SEED 1
+#define BATCH_LANES 4
+
+// frame number -> framebuffer hash
+typedef std::map<uint64_t, uint64_t> Hashes;
+
+static const char *ENGINES[] = {"interpreter", "threaded", "jit", "batch"};
+
+struct Job
+{
+    std::string rom;
+    std::string engine;
+    Hashes hashes;
+    std::string error;
+};
+
+// the file part of a golden entry
+static std::string rom_file(const std::string &entry)
+{
+    return entry.substr(0, entry.find(':'));
+}
+
+// .sc8 and .xo8 ROMs run as SUPER-CHIP and XO-CHIP, on the interpreter only
+static Variant rom_variant(const std::string &rom)
+{
+    std::string ext = std::filesystem::path(rom_file(rom)).extension().string();
+    return ext == ".sc8" ? Variant::SCHIP : ext == ".xo8" ? Variant::XOCHIP : Variant::CHIP8;
+}
+
+// the profile an entry runs under: the forced one, or the ROM database's
+static QuirkProfile entry_quirks(const std::string &dir, const std::string &entry)
+{
+    QuirkProfile profile = QuirkProfile::MODERN;
+    size_t colon = entry.find(':');
+    if (colon != std::string::npos)
+    {
+        if (!parse_quirks(entry.substr(colon + 1), profile))
+        {
+            std::cout << "unknown quirks in " << entry << "\n";
+            exit(1);
+        }
+        return profile;
+    }
+    std::ifstream in(dir + "/" + rom_file(entry), std::ios::binary);
+    std::vector<uint8_t> image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    uint8_t digest[SHA1_SIZE];
+    sha1(image.data(), image.size(), digest);
+    find_quirks(digest, profile);
+    return profile;
+}
+
+static Hashes run_chip8(const std::string &dir, const std::string &entry, Engine engine)
+{
+    std::string path = dir + "/" + rom_file(entry);
+    CHIP8 chip8(false, std::make_unique<NullDisplay>(), std::make_unique<NullKeypad>());
+    chip8.set_variant(rom_variant(path));
+    chip8.set_engine(engine);
+    if (entry.find(':') != std::string::npos)
+    {
+        chip8.set_quirks(entry_quirks(dir, entry));
+    }
+    chip8.seed(REGRESS_SEED);
+    chip8.set_speed(REGRESS_IPF);
+    chip8.load_ROM(path.c_str());
+    Hashes hashes;
+    for (uint64_t frame = 1; frame <= REGRESS_FRAMES; ++frame)
+    {
+        chip8.run_frame();
+        if (frame % REGRESS_CHECKPOINT == 0)
+        {
+            hashes[frame] = chip8.framebuffer().hash();
+        }
+    }
+    return hashes;
+}
+
+// every lane runs the same seed, so every lane has to land on the same screen
+static Hashes run_batch(const std::string &path, std::string &error)
+{
+    Batch batch(BATCH_LANES);
+    batch.set_speed(REGRESS_IPF);
+    batch.load_ROM(path.c_str());
+    for (size_t lane = 0; lane < BATCH_LANES; ++lane)
+    {
+        batch.seed(lane, REGRESS_SEED);
+    }
+    Hashes hashes;
+    for (uint64_t frame = 1; frame <= REGRESS_FRAMES; ++frame)
+    {
+        batch.run_frame();
+        if (frame % REGRESS_CHECKPOINT == 0)
+        {
+            hashes[frame] = batch.framebuffer(0).hash();
+            for (size_t lane = 1; lane < BATCH_LANES; ++lane)
+            {
+                if (batch.framebuffer(lane).hash() != hashes[frame] && error.empty())
+                {
+                    error = "lane " + std::to_string(lane) + " differs at frame " + std::to_string(frame);
+                }
+            }
+        }
+    }
+    return hashes;
+}
+
+// golden lines are "rom frame hash", # starts a comment
+static std::map<std::string, Hashes> read_golden(const std::string &filename)
+{
+    std::ifstream in(filename);
+    if (!in.is_open())
+    {
+        std::cout << "cannot open " << filename << "\n";
+        exit(1);
+    }
+    std::map<std::string, Hashes> golden;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string rom;
+        uint64_t frame;
+        std::string hash;
+        if (!(fields >> rom >> frame >> hash))
+        {
+            std::cout << "bad golden line: " << line << "\n";
+            exit(1);
+        }
+        golden[rom][frame] = strtoull(hash.c_str(), nullptr, 16);
+    }
+    return golden;
+}
+
+static void write_golden(const std::string &filename, const std::vector<Job> &jobs)
+{
+    std::ofstream out(filename);
+    out << "# rom frame fnv1a64, " << REGRESS_IPF << " instructions per frame, seed " << REGRESS_SEED << "\n";
+    for (auto &job : jobs)
+    {
+        for (auto &h : job.hashes)
+        {
+            char hash[17];
+            snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(h.second));
+            out << job.rom << " " << h.first << " " << hash << "\n";
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = "roms";
+    std::string golden_file = "roms/golden.txt";
+    bool update = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("roms=", 0) == 0)
+        {
+            dir = arg.substr(5);
+        }
+        else if (arg.rfind("golden=", 0) == 0)
+        {
+            golden_file = arg.substr(7);
+        }
+        else if (arg == "update")
+        {
+            update = true;
+        }
+        else
+        {
+            std::cout << "usage: regress [roms=DIR] [golden=FILE] [update]\n";
+            exit(1);
+        }
+    }
+
+    // update records every ROM in the directory from the interpreter
+    std::vector<Job> jobs;
+    std::map<std::string, Hashes> golden;
+    if (update)
+    {
+        std::vector<std::string> roms;
+        for (auto &entry : std::filesystem::directory_iterator(dir))
+        {
+            std::string ext = entry.path().extension().string();
+            if (ext == ".ch8" || ext == ".rom" || ext == ".sc8" || ext == ".xo8")
+            {
+                roms.push_back(entry.path().filename().string());
+            }
+        }
+        std::sort(roms.begin(), roms.end());
+        // the plain entry runs under the profile the ROM database picks, and
+        // CHIP-8 ROMs also under every other one, which is what puts the
+        // quirk paths of each engine under test
+        for (auto &rom : roms)
+        {
+            jobs.push_back({rom, "interpreter", {}, ""});
+            QuirkProfile own = entry_quirks(dir, rom);
+            for (int i = 0; rom_variant(rom) == Variant::CHIP8 && i < QUIRK_PROFILES; ++i)
+            {
+                if (static_cast<QuirkProfile>(i) != own)
+                {
+                    jobs.push_back({rom + ":" + quirks_name(static_cast<QuirkProfile>(i)), "interpreter", {}, ""});
+                }
+            }
+        }
+    }
+    else
+    {
+        golden = read_golden(golden_file);
+        for (auto &g : golden)
+        {
+            for (const char *engine : ENGINES)
+            {
+                // batch lanes only run the MODERN quirks
+                bool batchable = entry_quirks(dir, g.first) == QuirkProfile::MODERN;
+                if ((rom_variant(g.first) == Variant::CHIP8 && (batchable || std::string(engine) != "batch")) ||
+                    std::string(engine) == "interpreter")
+                {
+                    jobs.push_back({g.first, engine, {}, ""});
+                }
+            }
+        }
+    }
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < jobs.size(); i = next++)
+        {
+            Job &job = jobs[i];
+            if (job.engine == "batch")
+            {
+                job.hashes = run_batch(dir + "/" + rom_file(job.rom), job.error);
+            }
+            else
+            {
+                Engine engine = job.engine == "jit" ? Engine::JIT
+                                : job.engine == "threaded" ? Engine::THREADED
+                                                           : Engine::INTERPRETER;
+                job.hashes = run_chip8(dir, job.rom, engine);
+            }
+        }
+    };
+    size_t count = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::min(count, jobs.size()); ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    if (update)
+    {
+        write_golden(golden_file, jobs);
+        std::cout << "wrote " << jobs.size() << " entries to " << golden_file << "\n";
+        return 0;
+    }
+    int failures = 0;
+    for (auto &job : jobs)
+    {
+        const Hashes &expected = golden[job.rom];
+        std::string error = job.error;
+        for (auto &h : expected)
+        {
+            auto got = job.hashes.find(h.first);
+            if (error.empty() && (got == job.hashes.end() || got->second != h.second))
+            {
+                error = "frame " + std::to_string(h.first) + " does not match";
+            }
+        }
+        failures += !error.empty();
+        std::cout << (error.empty() ? "ok   " : "FAIL ") << job.rom << " " << job.engine
+                  << (error.empty() ? "" : ": " + error) << "\n";
+    }
+    if (failures > 0)
+    {
+        std::cout << failures << " of " << jobs.size() << " runs failed\n";
+        return 1;
+    }
+}
@@ -0,0 +1,43 @@
+#include "Trace.h"
+#include "Disasm.h"
+#include <cstdio>
+#include <iostream>
+
+// prints a binary trace written with trace=FILE as text
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: tracedump trace\n";
+        exit(1);
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (in == nullptr)
+    {
+        std::cout << "cannot open file\n";
+        exit(1);
+    }
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != TRACE_MAGIC ||
+        header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord))
+    {
+        std::cout << "not a trace file\n";
+        exit(1);
+    }
+    TraceRecord r;
+    while (fread(&r, sizeof(r), 1, in) == 1)
+    {
+        printf("%10llu  %03X  %04X  %-16s I=%03X", (unsigned long long)r.cycle, r.pc, r.opcode,
+               disassemble(r.opcode).c_str(), r.ic);
+        // only the registers the instruction changed
+        for (int i = 0; i < 16; ++i)
+        {
+            if (r.changed & (1 << i))
+            {
+                printf(" V%X=%02X", i, r.V[i]);
+            }
+        }
+        printf("\n");
+    }
+    fclose(in);
+}